@@ -0,0 +1,74 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBPIN_H
+#define LIBPIN_H
+
+
+/*
+ * Placement hints for the threads of an application. The hints are tags the
+ * rules of PIN_RULES are matched against, like "role:latency" or
+ * "group:shard-3". When pin.so is preloaded, its own implementation is used,
+ * otherwise libpin places the calling thread itself.
+ * The cpu_set_t type needs _GNU_SOURCE to be defined before <sched.h>.
+ */
+
+#include <sched.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+enum pin_role
+{
+	PIN_ROLE_DEFAULT = 0,
+	PIN_ROLE_LATENCY,
+	PIN_ROLE_THROUGHPUT,
+	PIN_ROLE_BACKGROUND
+};
+
+
+/*
+ * Give a role to the calling thread, which is placed again accordingly.
+ * Return 0 on success, or -1 with errno set.
+ */
+int pin_hint(int role);
+
+/*
+ * Put the threads created by the calling thread in the named group, until
+ * pin_group_end() is called. Return 0 on success, or -1 with errno set.
+ */
+int pin_group_begin(const char *name);
+
+int pin_group_end(void);
+
+/*
+ * Store the mask the calling thread is pinned on, numbered like PIN_MAP
+ * translates it back. Return 0 on success, or -1 with errno set to ESRCH if
+ * the thread is not pinned.
+ */
+int pin_current_mask(size_t size, cpu_set_t *mask);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
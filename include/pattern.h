@@ -0,0 +1,35 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIN_PATTERN_H
+#define PIN_PATTERN_H
+
+
+#include <stddef.h>
+#include <sys/types.h>
+
+
+/*
+ * Copy the pattern in dest, replacing each "%p" by the given pid and each "%%"
+ * by a single '%'. Return 0 on success or -1 if dest is too short.
+ */
+int expand_pattern(char *dest, size_t len, const char *pattern, pid_t pid)
+	__attribute__((visibility("hidden")));
+
+
+#endif
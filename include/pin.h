@@ -22,26 +22,157 @@
 
 #define _GNU_SOURCE
 
+#include <pthread.h>
 #include <sched.h>
+#include <sys/types.h>
 
 
 #define __hidden  __attribute__((visibility("hidden")))
 
+/*
+ * Thread-local storage of pin.so. The library is loaded at startup, so its
+ * variables can live in the static TLS block and be reached without calling
+ * __tls_get_addr().
+ */
+#define __tls     __thread __attribute__((tls_model("initial-exec")))
+
+#define CACHELINE_SIZE  64
+#define THREAD_NAME_LEN 16
+
 
 void  warning(const char *format, ...)
 	__hidden;
 
 void error(const char *format, ...)
-	__hidden;
+	__hidden __attribute__((noreturn));
 
 void errorp(const char *format, ...)
+	__hidden __attribute__((noreturn));
+
+
+struct placement;
+
+struct slot
+{
+	struct placement  *placement;
+	size_t             index;
+};
+
+/*
+ * Scheduling attributes of a mask, where the value is the priority of the
+ * real-time policies or the nice value of the others.
+ */
+struct schedule
+{
+	int  policy;      /* SCHED_* or -1 to leave the thread unchanged */
+	int  value;
+};
+
+/*
+ * What the placement rules are matched against: the name of a thread, the
+ * symbol of its start routine and the tags given through libpin.
+ */
+struct thread_keys
+{
+	const char  *name;
+	const char  *symbol;
+	const char  *role;       /* "role:<role>" from pin_hint() */
+	const char  *group;      /* "group:<name>" from pin_group_begin() */
+};
+
+struct thread_record
+{
+	int                lock;
+	pid_t              tid;
+	const cpu_set_t   *set;      /* mask the thread is pinned on, or NULL */
+	struct slot        slot;
+	struct schedule    original; /* attributes before the mask ones */
+	int                moved;    /* mask changed since the mempolicy */
+	pthread_t          thread;
+	unsigned long      created;  /* creation time, in nanoseconds */
+	const char        *symbol;   /* start routine symbol, or NULL */
+	const char        *role;     /* role tag, or NULL */
+	const char        *group;    /* group tag, or NULL */
+	char               name[THREAD_NAME_LEN];
+};
+
+struct cpumap
+{
+	size_t                 words;
+	unsigned long         *keep;
+	struct cpumap_group   *groups;
+};
+
+struct numa_node
+{
+	int         id;
+	cpu_set_t  *cpus;
+};
+
+struct cpu_topology
+{
+	int         cpu;
+	int         package;
+	int         die;
+	int         llc;         /* first cpu sharing the last level cache */
+	int         core;        /* first cpu of the physical core */
+	int         smt;         /* rank of the cpu among the core siblings */
+	int         core_rank;   /* rank of the core in the last level cache */
+	int         llc_rank;    /* rank of the last level cache in package */
+	cpu_set_t  *siblings;
+};
+
+
+size_t cpumask_size(void)
 	__hidden;
 
+static inline cpu_set_t *cpumask_at(cpu_set_t *masks, size_t index)
+{
+	return (cpu_set_t *) ((char *) masks + index * cpumask_size());
+}
+
+int parse_cpumask(cpu_set_t *dest, const char *word, size_t len)
+	__hidden;
 
 void acquire_arguments(void)
 	__hidden;
 
-const cpu_set_t *get_next_cpumask(void)
+int reconfigure(const char *argname, const char *arg)
+	__hidden;
+
+int rules_active(void)
+	__hidden;
+
+const cpu_set_t *get_next_cpumask(struct slot *slot,
+				  const struct thread_keys *keys)
+	__hidden;
+
+const cpu_set_t *get_cpumask_at(struct slot *slot,
+				const struct thread_keys *keys, size_t index)
+	__hidden;
+
+void put_cpumask(const struct slot *slot)
+	__hidden;
+
+const cpu_set_t *refresh_cpumask(struct thread_record *record)
+	__hidden;
+
+const cpu_set_t *move_cpumask(struct slot *slot, size_t index)
+	__hidden;
+
+void adopt_cpumask(const struct slot *slot)
+	__hidden;
+
+size_t placement_size(const struct placement *placement)
+	__hidden;
+
+size_t placement_lead(const struct placement *placement)
+	__hidden;
+
+const struct schedule *slot_schedule(const struct slot *slot)
+	__hidden;
+
+size_t placement_cpus(cpu_set_t *dest)
 	__hidden;
 
 void map_cpuset_forward(cpu_set_t *dest, const cpu_set_t *src, size_t len)
@@ -50,7 +181,188 @@ void map_cpuset_forward(cpu_set_t *dest, const cpu_set_t *src, size_t len)
 void map_cpuset_reverse(cpu_set_t *dest, const cpu_set_t *src, size_t len)
 	__hidden;
 
-int map_cpu_reverse(int cpu)
+int map_cpu_forward(int cpu)
+	__hidden;
+
+extern const int *cpu_reverse_table
+	__hidden;
+
+static inline int map_cpu_reverse(int cpu)
+{
+	const int *table = __atomic_load_n(&cpu_reverse_table,
+					   __ATOMIC_ACQUIRE);
+
+	if (table == NULL)
+		return cpu;
+	return table[cpu + 1];
+}
+
+
+int compile_cpumap(struct cpumap *dest, const size_t *translate, size_t len)
+	__hidden;
+
+void translate_cpuset(cpu_set_t *dest, const cpu_set_t *src, size_t len,
+		      const struct cpumap *map)
+	__hidden;
+
+
+int attach_shared(const char *name, size_t total, unsigned long signature,
+		  size_t **cursor, size_t **occupancy, size_t **own)
+	__hidden;
+
+void detach_shared(void)
+	__hidden;
+
+
+int acquire_mempolicy(const char *arg)
+	__hidden;
+
+void apply_mempolicy(const cpu_set_t *set)
+	__hidden;
+
+
+int parse_schedule(struct schedule *dest, const char *str, size_t len)
+	__hidden;
+
+void apply_schedule(pid_t tid, const struct schedule *schedule,
+		    struct schedule *original)
+	__hidden;
+
+
+
+struct thread_record *register_thread(void)
+	__hidden;
+
+void unregister_thread(struct thread_record *record)
+	__hidden;
+
+void lock_thread(struct thread_record *record)
+	__hidden;
+
+void unlock_thread(struct thread_record *record)
+	__hidden;
+
+int thread_index(const struct thread_record *record, size_t *index)
+	__hidden;
+
+void for_each_thread(void (*func)(struct thread_record *, void *), void *arg)
+	__hidden;
+
+void publish_thread(const struct thread_record *record)
+	__hidden;
+
+int *observed_cpu(const struct thread_record *record)
+	__hidden;
+
+void repin_threads(void)
+	__hidden;
+
+void move_thread(struct thread_record *record, size_t index)
+	__hidden;
+
+
+int open_registry(const char *pattern)
+	__hidden;
+
+void write_registry(size_t index, pid_t tid, long mask,
+		    unsigned long created)
+	__hidden;
+
+int *registry_cpu(size_t index)
+	__hidden;
+
+
+#define IDENTITY_LEN  128
+
+int open_record(const char *pattern)
+	__hidden;
+
+int open_replay(const char *path)
+	__hidden;
+
+int manifest_active(void)
+	__hidden;
+
+int replay_placement(const char *identity, const char *symbol,
+		     size_t *index)
+	__hidden;
+
+void record_placement(const char *identity, const char *symbol,
+		      size_t index)
+	__hidden;
+
+
+int open_trace(const char *pattern)
+	__hidden;
+
+void release_trace(void)
+	__hidden;
+
+unsigned long trace_start(void)
+	__hidden;
+
+void trace_event(unsigned long start, int type, pid_t target,
+		 const cpu_set_t *input, const cpu_set_t *output, size_t len,
+		 int error)
+	__hidden;
+
+
+int open_control(const char *pattern)
+	__hidden;
+
+void *serve_control(void *arg)
+	__hidden;
+
+
+void acquire_nprocs(const char *arg)
+	__hidden;
+
+
+int role_tag(int role, const char **tag)
+	__hidden;
+
+const char *group_tag(const char *name)
+	__hidden;
+
+
+int acquire_rebalance(const char *arg)
+	__hidden;
+
+void *serve_rebalance(void *arg)
+	__hidden;
+
+
+int sysfs_path(char *dest, size_t len, const char *format, ...)
+	__hidden;
+
+ssize_t sysfs_read(char *dest, size_t len, const char *format, ...)
+	__hidden;
+
+int sysfs_cpulist(cpu_set_t *dest, const char *format, ...)
+	__hidden;
+
+int read_affinity(cpu_set_t *dest)
+	__hidden;
+
+int read_allowed_cpus(cpu_set_t *dest)
+	__hidden;
+
+int read_cpu_class(cpu_set_t *dest, const char *name)
+	__hidden;
+
+int read_core_classes(cpu_set_t *perf, cpu_set_t *eff)
+	__hidden;
+
+ssize_t read_numa_nodes(struct numa_node **dest)
+	__hidden;
+
+void free_numa_nodes(struct numa_node *nodes, size_t count)
+	__hidden;
+
+ssize_t read_cpu_topology(struct cpu_topology **dest)
+	__hidden;
+
+void free_cpu_topology(struct cpu_topology *cpus, size_t count)
 	__hidden;
 
 
@@ -47,6 +47,8 @@ int for_pid_stat(pid_t pid,
 		 int (*cb)(pid_t, const struct task_stat *, void *),
 		 void *data);
 
+int pid_cgroup(pid_t pid, char *dest, size_t len);
+
 
 int foreach_pid(int (*cb)(pid_t, void *), void *data);
 
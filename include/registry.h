@@ -0,0 +1,81 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIN_REGISTRY_H
+#define PIN_REGISTRY_H
+
+
+#include <stddef.h>
+#include <sys/types.h>
+
+
+#define REGISTRY_MAGIC    0x70696e72u
+#define REGISTRY_RECORDS  4096
+
+
+/*
+ * A record is written under a sequence lock: the sequence is odd while the
+ * writer updates the record, and readers retry when the sequence is odd or
+ * changed while they copied the record. The last observed cpu is only written
+ * by the thread itself and may be read without the sequence lock.
+ */
+struct registry_record
+{
+	unsigned int   sequence;
+	pid_t          tid;          /* 0 if the record is free */
+	long           mask;         /* index of the pinning mask, or -1 */
+	unsigned long  created;      /* creation time, in nanoseconds */
+	int            cpu;          /* last observed cpu, or -1 */
+} __attribute__((aligned(32)));
+
+struct registry_header
+{
+	unsigned int            magic;
+	unsigned int            records;
+	pid_t                   pid;
+	struct registry_record  record[];
+};
+
+
+static inline size_t registry_size(size_t records)
+{
+	return sizeof (struct registry_header)
+		+ records * sizeof (struct registry_record);
+}
+
+static inline void read_registry_record(struct registry_record *dest,
+					const struct registry_record *src)
+{
+	unsigned int before, after;
+
+	do {
+		before = __atomic_load_n(&src->sequence, __ATOMIC_ACQUIRE);
+		dest->tid = __atomic_load_n(&src->tid, __ATOMIC_RELAXED);
+		dest->mask = __atomic_load_n(&src->mask, __ATOMIC_RELAXED);
+		dest->created = __atomic_load_n(&src->created,
+						__ATOMIC_RELAXED);
+		dest->cpu = __atomic_load_n(&src->cpu, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		after = __atomic_load_n(&src->sequence, __ATOMIC_RELAXED);
+	} while ((before & 1) || before != after);
+
+	dest->sequence = after;
+}
+
+
+#endif
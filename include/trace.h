@@ -0,0 +1,94 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIN_TRACE_H
+#define PIN_TRACE_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define TRACE_MAGIC       0x70696e74u
+#define TRACE_RINGS       256
+#define TRACE_EVENTS      1024         /* events per ring */
+#define TRACE_MASK_WORDS  4            /* the masks keep the first 256 cpus */
+
+#define TRACE_CREATE       0
+#define TRACE_SETAFFINITY  1
+#define TRACE_GETAFFINITY  2
+#define TRACE_REBALANCE    3
+#define TRACE_REPIN        4
+#define TRACE_TYPES        5
+
+
+/*
+ * An intercepted call or a placement decision. The input mask is the one the
+ * program gives (or the previous mask of a moved thread) and the output mask
+ * the one given to the kernel (or returned to the program), so the difference
+ * is the translation of PIN_MAP. The target is the other thread concerned:
+ * the thread moved by a rebalance, the creator of a new thread, or the thread
+ * given to sched_setaffinity(), and 0 for the calling thread or if unknown.
+ */
+struct trace_event
+{
+	uint64_t  time;          /* CLOCK_MONOTONIC, in nanoseconds */
+	uint32_t  duration;      /* time spent in the call, in nanoseconds */
+	uint16_t  type;
+	uint16_t  error;         /* error number, or 0 on success */
+	int32_t   tid;
+	int32_t   target;
+	uint64_t  input[TRACE_MASK_WORDS];
+	uint64_t  output[TRACE_MASK_WORDS];
+};
+
+/*
+ * A ring is claimed by a thread, which is its only writer: the event at the
+ * head (modulo the ring size) is written, then the head is incremented with
+ * a release store. The ring is given back when the thread exits, so the
+ * events of a ring can come from successive threads.
+ */
+struct trace_ring
+{
+	uint64_t            head;        /* count of events ever written */
+	int32_t             tid;         /* current owner, or 0 */
+	uint32_t            unused;
+	struct trace_event  event[TRACE_EVENTS];
+} __attribute__((aligned(64)));
+
+struct trace_header
+{
+	uint32_t           magic;
+	uint32_t           rings;
+	uint32_t           events;
+	uint32_t           mask_words;
+	int32_t            pid;
+	uint32_t           unused;
+	uint64_t           dropped;      /* events of threads without a ring */
+	struct trace_ring  ring[];
+};
+
+
+static inline size_t trace_size(size_t rings)
+{
+	return sizeof (struct trace_header)
+		+ rings * sizeof (struct trace_ring);
+}
+
+
+#endif
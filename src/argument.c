@@ -21,19 +21,91 @@
 #include <pin.h>
 
 #include <ctype.h>
+#include <fnmatch.h>
 #include <sched.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 
-static size_t      next_mask;
-static size_t      total_masks = 0;
-static cpu_set_t  *all_masks;
+#define CURSOR_BATCH    16
+#define PROBE_MAXSIZE   (1ul << 20)
 
-static size_t      total_map = 0;
-static size_t     *map_forward;
-static size_t     *map_reverse;
+#define CORE_CLASS_PERF  0
+#define CORE_CLASS_EFF   1
+
+
+/*
+ * A placement is the table of masks handed out to the new threads with the
+ * occupancy of each mask. The occupancy and the cursor are either private to
+ * the placement or located in a shared memory segment (see PIN_SHARED).
+ */
+struct placement
+{
+	struct
+	{
+		size_t  value;
+		char    padding[CACHELINE_SIZE - sizeof (size_t)];
+	} next __attribute__((aligned(CACHELINE_SIZE)));
+
+	size_t       total;
+	size_t       lead;     /* masks handed out once, before the cycle */
+	cpu_set_t   *masks;
+	struct schedule  *schedules;   /* attributes of each mask, or NULL */
+	size_t      *local_occupancy;
+	size_t      *cursor;
+	size_t      *occupancy;
+	size_t      *own_occupancy;
+};
+
+struct rule
+{
+	char              *pattern;
+	struct placement  *placement;
+};
+
+struct ruleset
+{
+	size_t       count;
+	struct rule  rules[];
+};
+
+struct mapping
+{
+	size_t         total;
+	size_t        *forward;
+	size_t        *reverse;
+	struct cpumap  cpumap_forward;
+	struct cpumap  cpumap_reverse;
+	const int     *reverse_table;
+};
+
+
+static size_t             mask_size = 0;
+
+/*
+ * The current placement and mapping can be replaced at any time by a control
+ * request, so they are only accessed through atomic loads. A replaced
+ * placement or mapping is never freed since other threads may still use it.
+ */
+static struct placement  *current_placement = NULL;
+static struct mapping    *current_mapping = NULL;
+static struct ruleset    *current_rules = NULL;
+static struct placement  *shared_placement = NULL;
+
+const int                *cpu_reverse_table = NULL;
+
+static cpu_set_t         *allowed_cpus = NULL;
+static int               *allowed_list;
+static size_t             allowed_count = 0;
+static int                relative_cpus = 0;
+
+static __thread struct placement  *batch_placement = NULL;
+static __thread size_t             batch_next;
+static __thread size_t             batch_left = 0;
 
 
 static void *inner_malloc(size_t len)
@@ -46,6 +118,123 @@ static void *inner_malloc(size_t len)
 	return addr;
 }
 
+/*
+ * The size of the kernel cpumasks is returned by the raw sched_getaffinity
+ * system call, which fails with EINVAL as long as the buffer is too small.
+ */
+static size_t probe_cpumask_size(void)
+{
+	size_t len = sizeof (unsigned long);
+	void *buffer;
+	long ret;
+
+	while (len <= PROBE_MAXSIZE) {
+		if ((buffer = malloc(len)) == NULL)
+			break;
+		ret = syscall(SYS_sched_getaffinity, 0, len, buffer);
+		free(buffer);
+
+		if (ret > 0)
+			return ret;
+		if (errno != EINVAL)
+			break;
+
+		len <<= 1;
+	}
+
+	return sizeof (cpu_set_t);
+}
+
+size_t cpumask_size(void)
+{
+	if (mask_size == 0)
+		mask_size = probe_cpumask_size();
+	return mask_size;
+}
+
+static cpu_set_t *alloc_cpumasks(size_t count)
+{
+	return inner_malloc(cpumask_size() * count);
+}
+
+/*
+ * Restrict the masks to the allowed cpus and drop the masks left empty, with
+ * their scheduling attributes.
+ */
+static size_t restrict_cpumasks(cpu_set_t *masks, struct schedule *schedules,
+				size_t total)
+{
+	size_t i, kept = 0, size = cpumask_size();
+	cpu_set_t *mask;
+
+	if (allowed_cpus == NULL)
+		return total;
+
+	for (i=0; i<total; i++) {
+		mask = cpumask_at(masks, i);
+		CPU_AND_S(size, mask, mask, allowed_cpus);
+		if (CPU_COUNT_S(size, mask) == 0)
+			continue;
+		if (kept != i)
+			memcpy(cpumask_at(masks, kept), mask, size);
+		if (kept != i && schedules != NULL)
+			schedules[kept] = schedules[i];
+		kept++;
+	}
+
+	if (kept == 0 && total > 0)
+		warning("no allowed cpu in the placement masks");
+
+	return kept;
+}
+
+/*
+ * With PIN_RELATIVE, the cpus of a list are indices in the allowed cpus,
+ * wrapping around, so a list fits whatever the number of allowed cpus.
+ */
+static void relative_cpumask(cpu_set_t *mask)
+{
+	size_t i, size = cpumask_size();
+	cpu_set_t *copy;
+
+	if (!relative_cpus || allowed_count == 0)
+		return;
+
+	copy = alloca(size);
+	memcpy(copy, mask, size);
+	CPU_ZERO_S(size, mask);
+
+	for (i=0; i < (size << 3); i++)
+		if (CPU_ISSET_S(i, size, copy))
+			CPU_SET_S(allowed_list[i % allowed_count], size, mask);
+}
+
+static struct placement *new_placement(cpu_set_t *masks,
+				       struct schedule *schedules, size_t total)
+{
+	struct placement *placement = inner_malloc(sizeof (*placement));
+
+	if (placement == NULL)
+		return NULL;
+
+	total = restrict_cpumasks(masks, schedules, total);
+
+	placement->local_occupancy = inner_malloc(sizeof (size_t) * total);
+	if (total > 0 && placement->local_occupancy == NULL)
+		return NULL;
+
+	placement->next.value = 0;
+	placement->total = total;
+	placement->lead = 0;
+	placement->masks = masks;
+	placement->schedules = schedules;
+	placement->cursor = &placement->next.value;
+	placement->occupancy = placement->local_occupancy;
+	placement->own_occupancy = NULL;
+
+	return placement;
+}
+
 static size_t count_words(const char *arg)
 {
 	size_t count = 0;
@@ -87,16 +276,17 @@ static const char *next_word(const char *str, const char **word)
 }
 
 
-static int parse_cpumask(cpu_set_t *dest, const char *word, size_t len)
+int parse_cpumask(cpu_set_t *dest, const char *word, size_t len)
 {
 	char *buffer = alloca(len + 1);
 	long i, start, end, swap;
+	size_t size = cpumask_size();
 	char *ptr;
 
 	memcpy(buffer, word, len);
 	buffer[len] = '\0';
 	
-	CPU_ZERO(dest);
+	CPU_ZERO_S(size, dest);
 
 	while (1) {
 		start = strtol(buffer, &ptr, 10);
@@ -116,8 +306,11 @@ static int parse_cpumask(cpu_set_t *dest, const char *word, size_t len)
 			end = swap;
 		}
 
+		if ((size_t) end >= (size << 3))
+			end = (size << 3) - 1;
+
 		for (i=start; i <= end; i++)
-			CPU_SET(i, dest);
+			CPU_SET_S(i, size, dest);
 		
 		if (*buffer != ',')
 			break;
@@ -130,31 +323,528 @@ static int parse_cpumask(cpu_set_t *dest, const char *word, size_t len)
 }
 
 
-static void acquire_round_robin(const char *arg, const char *argname)
+/*
+ * The allowed cores of a class of a hybrid processor, SMT siblings last, and
+ * the next one to hand out in a list of masks.
+ */
+struct core_class
 {
-	size_t count = 0, total = count_words(arg);
-	cpu_set_t *masks = inner_malloc(sizeof (cpu_set_t) * total);
-	const char *word;
-	int err;
+	int     *cpus;
+	size_t   count;
+	size_t   next;
+};
 
-	if (masks == NULL)
-		errorp("failed to parse '%s' = '%s'", argname, arg);
+static int load_core_classes(struct core_class *classes)
+{
+	size_t c, size = cpumask_size();
+	cpu_set_t *sets[2] = { alloca(size), alloca(size) };
+	struct cpu_topology *cpus;
+	ssize_t i, count;
+	int cpu, rank, max_rank = 0, *ranks;
 
-	arg = next_word(arg, &word);
+	if (read_core_classes(sets[CORE_CLASS_PERF], sets[CORE_CLASS_EFF]) != 0)
+		return -1;
+	if ((ranks = calloc(size << 3, sizeof (int))) == NULL)
+		return -1;
+
+	if ((count = read_cpu_topology(&cpus)) > 0) {
+		for (i=0; i<count; i++) {
+			ranks[cpus[i].cpu] = cpus[i].smt;
+			if (cpus[i].smt > max_rank)
+				max_rank = cpus[i].smt;
+		}
+		free_cpu_topology(cpus, count);
+	}
+
+	for (c=0; c<2; c++) {
+		if (allowed_cpus != NULL)
+			CPU_AND_S(size, sets[c], sets[c], allowed_cpus);
+
+		classes[c].next = 0;
+		classes[c].count = 0;
+		classes[c].cpus = malloc(sizeof (int)
+					 * (CPU_COUNT_S(size, sets[c]) + 1));
+		if (classes[c].cpus == NULL) {
+			free(ranks);
+			return -1;
+		}
+
+		for (rank=0; rank <= max_rank; rank++)
+			for (cpu=0; (size_t) cpu < (size << 3); cpu++)
+				if (CPU_ISSET_S(cpu, size, sets[c])
+				    && ranks[cpu] == rank)
+					classes[c].cpus[classes[c].count++] =
+						cpu;
+	}
+
+	free(ranks);
+	return 0;
+}
+
+/*
+ * A word "P" or "E" stands for the next performance or efficiency core, and
+ * "P*" or "E*" for one mask per remaining core of the class. Return the class
+ * of the word, or -1 for a regular mask.
+ */
+static int core_class_word(const char *word, size_t len, int *all)
+{
+	if (len < 1 || len > 2 || (word[0] != 'P' && word[0] != 'E'))
+		return -1;
+	if (len == 2 && word[1] != '*')
+		return -1;
+
+	*all = (len == 2);
+	return (word[0] == 'P') ? CORE_CLASS_PERF : CORE_CLASS_EFF;
+}
+
+static size_t class_cpumasks(cpu_set_t *masks, struct core_class *class,
+			     int all)
+{
+	size_t count = 0, size = cpumask_size();
+
+	if (!all) {
+		CPU_ZERO_S(size, masks);
+		if (class->count > 0)
+			CPU_SET_S(class->cpus[class->next++ % class->count],
+				  size, masks);
+		return 1;
+	}
+
+	while (class->next < class->count) {
+		CPU_ZERO_S(size, cpumask_at(masks, count));
+		CPU_SET_S(class->cpus[class->next++], size,
+			  cpumask_at(masks, count));
+		count++;
+	}
+
+	return count;
+}
+
+/*
+ * A word of a list of masks can end with the scheduling attributes of the
+ * threads pinned on its masks, like "0-3:fifo:50". Return the length of the
+ * word without them.
+ */
+static size_t mask_length(const char *word, size_t len)
+{
+	const char *colon = memchr(word, ':', len);
+
+	return (colon == NULL) ? len : (size_t) (colon - word);
+}
+
+static struct placement *build_round_robin(const char *arg)
+{
+	size_t c, i, len, first, count = 0, total = 0;
+	struct core_class classes[2] = { { NULL, 0, 0 }, { NULL, 0, 0 } };
+	struct schedule *schedules = NULL, schedule;
+	const char *ptr, *word;
+	cpu_set_t *masks;
+	int err = 0, class, all, loaded = 0, scheduled = 0;
+
+	ptr = next_word(arg, &word);
 	while (word != NULL) {
-		err = parse_cpumask(masks + count, word, arg - word);
-		if (err != 0)
-			error("failed to parse '%s' = '%s'", argname, arg);
-		
+		len = mask_length(word, ptr - word);
+		if (len < (size_t) (ptr - word))
+			scheduled = 1;
+
+		class = core_class_word(word, len, &all);
+		if (class >= 0 && !loaded) {
+			if (load_core_classes(classes) != 0)
+				return NULL;
+			loaded = 1;
+		}
+
+		total += (class >= 0 && all) ? classes[class].count : 1;
+		ptr = next_word(ptr, &word);
+	}
+
+	masks = alloc_cpumasks(total);
+	if (total > 0 && masks == NULL)
+		err = -1;
+	if (scheduled) {
+		schedules = inner_malloc(sizeof (*schedules) * total);
+		if (total > 0 && schedules == NULL)
+			err = -1;
+	}
+
+	arg = next_word(arg, &word);
+	while (err == 0 && word != NULL) {
+		len = mask_length(word, arg - word);
+		first = count;
+
+		class = core_class_word(word, len, &all);
+		if (class >= 0) {
+			count += class_cpumasks(cpumask_at(masks, count),
+						&classes[class], all);
+		} else {
+			err = parse_cpumask(cpumask_at(masks, count), word,
+					    len);
+			relative_cpumask(cpumask_at(masks, count));
+			count++;
+		}
+
+		schedule.policy = -1;
+		schedule.value = 0;
+		if (err == 0 && len < (size_t) (arg - word))
+			err = parse_schedule(&schedule, word + len + 1,
+					     arg - word - len - 1);
+
+		for (i=first; schedules != NULL && i<count; i++)
+			schedules[i] = schedule;
+
 		arg = next_word(arg, &word);
-		count++;
 	}
 
-	free(all_masks);
-	
-	next_mask = 0;
-	all_masks = masks;
-	total_masks = total;
+	for (c=0; c<2; c++)
+		free(classes[c].cpus);
+
+	if (err != 0)
+		return NULL;
+	return new_placement(masks, schedules, count);
+}
+
+
+static int select_node(size_t *selected, size_t *len, int id,
+		       const struct numa_node *nodes, size_t count)
+{
+	size_t i;
+
+	for (i=0; i<count; i++)
+		if (nodes[i].id == id)
+			break;
+
+	if (i == count || CPU_COUNT_S(cpumask_size(), nodes[i].cpus) == 0)
+		return -1;
+
+	for (id=0; (size_t) id < *len; id++)
+		if (selected[id] == i)
+			return 0;
+
+	selected[(*len)++] = i;
+	return 0;
+}
+
+static int parse_nodelist(size_t *selected, size_t *len, const char *str,
+			  const struct numa_node *nodes, size_t count)
+{
+	long id, start, end, step;
+	char *ptr;
+
+	while (1) {
+		start = strtol(str, &ptr, 10);
+		if (ptr == str)
+			return -1;
+		str = ptr;
+
+		if (*str == '-') {
+			str++;
+			end = strtol(str, &ptr, 10);
+			if (ptr == str)
+				return -1;
+			str = ptr;
+		} else {
+			end = start;
+		}
+
+		step = (start <= end) ? 1 : -1;
+		for (id = start; id != end + step; id += step)
+			if (select_node(selected, len, id, nodes, count) != 0)
+				return -1;
+
+		if (*str != ',')
+			break;
+		str++;
+	}
+
+	if (*str != '\0')
+		return -1;
+	return 0;
+}
+
+static struct placement *build_numa(const char *arg)
+{
+	size_t i, j, k, len = 0, total = 0, size = cpumask_size();
+	struct numa_node *nodes;
+	const char *list;
+	size_t *selected;
+	cpu_set_t *masks;
+	ssize_t count;
+	int fill;
+
+	if (strncmp(arg, "interleave", 10) == 0) {
+		fill = 0;
+		list = arg + 10;
+	} else if (strncmp(arg, "fill", 4) == 0) {
+		fill = 1;
+		list = arg + 4;
+	} else {
+		return NULL;
+	}
+
+	if (*list != '\0' && *list != ':')
+		return NULL;
+
+	if ((count = read_numa_nodes(&nodes)) < 0)
+		return NULL;
+	if ((selected = malloc(sizeof (size_t) * (count + 1))) == NULL)
+		goto err_nodes;
+
+	if (*list == ':') {
+		if (parse_nodelist(selected, &len, list + 1, nodes, count))
+			goto err_selected;
+	} else {
+		for (i=0; i < (size_t) count; i++)
+			if (CPU_COUNT_S(size, nodes[i].cpus) > 0)
+				selected[len++] = i;
+	}
+
+	if (len == 0)
+		goto err_selected;
+
+	for (i=0; i<len; i++)
+		total += fill ? (size_t) CPU_COUNT_S(size, nodes[selected[i]].cpus)
+			: 1;
+
+	if ((masks = alloc_cpumasks(total)) == NULL)
+		goto err_selected;
+
+	for (i=0, k=0; i<len; i++) {
+		j = fill ? (size_t) CPU_COUNT_S(size, nodes[selected[i]].cpus)
+			: 1;
+		while (j-- > 0)
+			memcpy(cpumask_at(masks, k++), nodes[selected[i]].cpus,
+			       size);
+	}
+
+	free(selected);
+	free_numa_nodes(nodes, count);
+
+	return new_placement(masks, NULL, total);
+ err_selected:
+	free(selected);
+ err_nodes:
+	free_numa_nodes(nodes, count);
+	return NULL;
+}
+
+
+static int compare_compact(const void *a, const void *b)
+{
+	const struct cpu_topology *ca = a, *cb = b;
+
+	if (ca->package != cb->package)
+		return ca->package - cb->package;
+	if (ca->die != cb->die)
+		return ca->die - cb->die;
+	if (ca->llc != cb->llc)
+		return ca->llc - cb->llc;
+	if (ca->core != cb->core)
+		return ca->core - cb->core;
+	return ca->smt - cb->smt;
+}
+
+static int compare_scatter(const void *a, const void *b)
+{
+	const struct cpu_topology *ca = a, *cb = b;
+
+	if (ca->smt != cb->smt)
+		return ca->smt - cb->smt;
+	if (ca->core_rank != cb->core_rank)
+		return ca->core_rank - cb->core_rank;
+	if (ca->llc_rank != cb->llc_rank)
+		return ca->llc_rank - cb->llc_rank;
+	if (ca->package != cb->package)
+		return ca->package - cb->package;
+	return ca->cpu - cb->cpu;
+}
+
+static struct placement *build_policy(const char *arg)
+{
+	int (*compare)(const void *, const void *);
+	struct cpu_topology *cpus;
+	size_t i, total = 0;
+	cpu_set_t *masks;
+	ssize_t count;
+	int per_core;
+
+	if (strcmp(arg, "compact") == 0) {
+		compare = compare_compact;
+		per_core = 0;
+	} else if (strcmp(arg, "scatter") == 0) {
+		compare = compare_scatter;
+		per_core = 0;
+	} else if (strcmp(arg, "one-per-core") == 0) {
+		compare = compare_compact;
+		per_core = 1;
+	} else {
+		return NULL;
+	}
+
+	if ((count = read_cpu_topology(&cpus)) <= 0)
+		return NULL;
+
+	qsort(cpus, count, sizeof (*cpus), compare);
+
+	if ((masks = alloc_cpumasks(count)) == NULL) {
+		free_cpu_topology(cpus, count);
+		return NULL;
+	}
+
+	for (i=0; i < (size_t) count; i++) {
+		if (per_core && cpus[i].smt != 0)
+			continue;
+
+		if (per_core)
+			memcpy(cpumask_at(masks, total), cpus[i].siblings,
+			       cpumask_size());
+		else
+			CPU_SET_S(cpus[i].cpu, cpumask_size(),
+				  cpumask_at(masks, total));
+
+		total++;
+	}
+
+	free_cpu_topology(cpus, count);
+
+	return new_placement(masks, NULL, total);
+}
+
+
+struct group_cpu
+{
+	int  domain;
+	int  smt;
+	int  core;
+	int  cpu;
+};
+
+static int compare_group(const void *a, const void *b)
+{
+	const struct group_cpu *ga = a, *gb = b;
+
+	if (ga->domain != gb->domain)
+		return ga->domain - gb->domain;
+	if (ga->smt != gb->smt)
+		return ga->smt - gb->smt;
+	return ga->core - gb->core;
+}
+
+static int node_domain(int cpu, const struct numa_node *nodes, size_t count)
+{
+	size_t i;
+
+	for (i=0; i<count; i++)
+		if (CPU_ISSET_S(cpu, cpumask_size(), nodes[i].cpus))
+			return nodes[i].id;
+	return 0;
+}
+
+/*
+ * Hand out the cpus in blocks of <size> consecutive masks, each block on the
+ * cpus of a single cache or node domain, one core after the other before
+ * their SMT siblings. The blocks alternate between the domains. The first
+ * mask, for the main thread, covers all the cpus.
+ */
+static struct placement *build_group(const char *arg)
+{
+	size_t i, j, k, len = 0, total, domains = 0, rounds = 0;
+	size_t group, size = cpumask_size();
+	struct numa_node *nodes = NULL;
+	struct placement *placement;
+	struct cpu_topology *cpus;
+	struct group_cpu *list;
+	ssize_t count, ncount = 0;
+	size_t *start, blocks;
+	cpu_set_t *masks;
+	char *end;
+	int node;
+
+	group = strtoul(arg, &end, 10);
+	if (group == 0 || end == arg)
+		return NULL;
+
+	if (*end == '\0' || strcmp(end, ":llc") == 0)
+		node = 0;
+	else if (strcmp(end, ":node") == 0)
+		node = 1;
+	else
+		return NULL;
+
+	if ((count = read_cpu_topology(&cpus)) <= 0)
+		return NULL;
+	if (node && (ncount = read_numa_nodes(&nodes)) < 0)
+		goto err_cpus;
+	if ((list = malloc(sizeof (*list) * count)) == NULL)
+		goto err_nodes;
+	if ((start = malloc(sizeof (*start) * (count + 1))) == NULL)
+		goto err_list;
+
+	for (i=0; i < (size_t) count; i++) {
+		if (allowed_cpus != NULL
+		    && !CPU_ISSET_S(cpus[i].cpu, size, allowed_cpus))
+			continue;
+
+		list[len].domain = node ? node_domain(cpus[i].cpu, nodes,
+						      ncount)
+			: cpus[i].llc;
+		list[len].smt = cpus[i].smt;
+		list[len].core = cpus[i].core;
+		list[len].cpu = cpus[i].cpu;
+		len++;
+	}
+
+	if (len == 0)
+		goto err_start;
+
+	qsort(list, len, sizeof (*list), compare_group);
+
+	for (i=0; i<len; i++)
+		if (i == 0 || list[i].domain != list[i - 1].domain)
+			start[domains++] = i;
+	start[domains] = len;
+
+	total = 1;
+	for (i=0; i<domains; i++) {
+		blocks = (start[i + 1] - start[i] + group - 1) / group;
+		if (blocks > rounds)
+			rounds = blocks;
+		total += blocks * group;
+	}
+
+	if ((masks = alloc_cpumasks(total)) == NULL)
+		goto err_start;
+
+	for (i=0; i<len; i++)
+		CPU_SET_S(list[i].cpu, size, cpumask_at(masks, 0));
+
+	total = 1;
+	for (j=0; j<rounds; j++)
+		for (i=0; i<domains; i++) {
+			len = start[i + 1] - start[i];
+			if (j * group >= len)
+				continue;
+			for (k=0; k<group; k++)
+				CPU_SET_S(list[start[i] + (j * group + k) % len]
+					  .cpu, size, cpumask_at(masks, total++));
+		}
+
+	free(start);
+	free(list);
+	free_numa_nodes(nodes, ncount);
+	free_cpu_topology(cpus, count);
+
+	if ((placement = new_placement(masks, NULL, total)) != NULL)
+		placement->lead = 1;
+	return placement;
+ err_start:
+	free(start);
+ err_list:
+	free(list);
+ err_nodes:
+	free_numa_nodes(nodes, ncount);
+ err_cpus:
+	free_cpu_topology(cpus, count);
+	return NULL;
 }
 
 
@@ -178,8 +868,31 @@ static int parse_mapping(size_t *from, size_t *to, const char *word, size_t l)
 	return 0;
 }
 
-static int compute_map(size_t *froms, size_t *tos, size_t len)
+/*
+ * The reverse table is indexed by cpu + 1 and covers every cpu the kernel can
+ * report, so sched_getcpu() translates without any bound check, including the
+ * -1 error value.
+ */
+static const int *compute_reverse_table(const size_t *reverse, size_t total)
 {
+	size_t i, len = cpumask_size() << 3;
+	int *table;
+
+	if (len < total)
+		len = total;
+	if ((table = inner_malloc(sizeof (int) * (len + 1))) == NULL)
+		return NULL;
+
+	table[0] = -1;
+	for (i=0; i<len; i++)
+		table[i + 1] = (i < total) ? (int) reverse[i] : (int) i;
+
+	return table;
+}
+
+static struct mapping *compute_map(size_t *froms, size_t *tos, size_t len)
+{
+	struct mapping *mapping;
 	size_t *forward, *reverse;
 	size_t i, max, total;
 
@@ -192,10 +905,12 @@ static int compute_map(size_t *froms, size_t *tos, size_t len)
 	}
 	total = max + 1;
 
+	if ((mapping = inner_malloc(sizeof (*mapping))) == NULL)
+		return NULL;
 	if ((forward = inner_malloc(sizeof (size_t) * total)) == NULL)
-		return -1;
+		return NULL;
 	if ((reverse = inner_malloc(sizeof (size_t) * total)) == NULL)
-		return -1;
+		return NULL;
 
 	for (i=0; i<total; i++) {
 		forward[i] = i;
@@ -207,117 +922,679 @@ static int compute_map(size_t *froms, size_t *tos, size_t len)
 		reverse[tos[i]] = froms[i];
 	}
 
-	total_map = total;
-	map_forward = forward;
-	map_reverse = reverse;
+	if (compile_cpumap(&mapping->cpumap_forward, forward, total) != 0)
+		return NULL;
+	if (compile_cpumap(&mapping->cpumap_reverse, reverse, total) != 0)
+		return NULL;
+	if ((mapping->reverse_table = compute_reverse_table(reverse, total))
+	    == NULL)
+		return NULL;
 
-	return 0;
+	mapping->total = total;
+	mapping->forward = forward;
+	mapping->reverse = reverse;
+
+	return mapping;
 }
 
-static void acquire_map(const char *arg, const char *argname)
+static struct mapping *build_map(const char *arg)
 {
 	size_t count = 0, total = count_words(arg);
-	const char *word, *origin = arg;
+	struct mapping *mapping = NULL;
 	size_t *froms, *tos;
-	int err;
+	const char *word;
 
-	if ((froms = malloc(sizeof (size_t) * total)) == NULL)
-		errorp("failed to parse '%s' = '%s'", argname, arg);
-	if ((tos = malloc(sizeof (size_t) * total)) == NULL)
-		errorp("failed to parse '%s' = '%s'", argname, arg);
+	froms = malloc(sizeof (size_t) * (total + 1));
+	tos = malloc(sizeof (size_t) * (total + 1));
+	if (froms == NULL || tos == NULL)
+		goto out;
 
 	arg = next_word(arg, &word);
 	while (word != NULL) {
-		err = parse_mapping(froms+count, tos+count, word, arg - word);
-		if (err != 0)
-			error("failed to parse '%s' = '%s'", argname, arg);
+		if (parse_mapping(froms+count, tos+count, word, arg - word))
+			goto out;
 
 		arg = next_word(arg, &word);
 		count++;
 	}
 
-	if (compute_map(froms, tos, count) != 0)
-		error("failed to parse '%s' = '%s'", argname, origin);
-
+	mapping = compute_map(froms, tos, count);
+ out:
 	free(froms);
 	free(tos);
+	return mapping;
+}
+
+
+static struct placement *build_cpu_round_robin(const char *arg)
+{
+	size_t i, count = 0, size = cpumask_size(), len = strcspn(arg, ":");
+	struct schedule *schedules = NULL, schedule;
+	cpu_set_t *cpus = alloca(size);
+	cpu_set_t *masks;
+
+	if (parse_cpumask(cpus, arg, len) != 0)
+		return NULL;
+	if (arg[len] == ':'
+	    && parse_schedule(&schedule, arg + len + 1, strlen(arg + len + 1)))
+		return NULL;
+
+	relative_cpumask(cpus);
+	if (CPU_COUNT_S(size, cpus) == 0)
+		return NULL;
+	if ((masks = alloc_cpumasks(CPU_COUNT_S(size, cpus))) == NULL)
+		return NULL;
+	if (arg[len] == ':') {
+		schedules = inner_malloc(sizeof (*schedules)
+					 * CPU_COUNT_S(size, cpus));
+		if (schedules == NULL)
+			return NULL;
+	}
+
+	for (i=0; i < (size << 3); i++) {
+		if (!CPU_ISSET_S(i, size, cpus))
+			continue;
+		if (schedules != NULL)
+			schedules[count] = schedule;
+		CPU_SET_S(i, size, cpumask_at(masks, count++));
+	}
+
+	return new_placement(masks, schedules, count);
+}
+
+static char *trim(char *str)
+{
+	char *end;
+
+	while (isspace(*str))
+		str++;
+
+	end = str + strlen(str);
+	while (end > str && isspace(end[-1]))
+		*--end = '\0';
+
+	return str;
+}
+
+/*
+ * A rule is "<pattern>=<target>" where the target is either a list of masks
+ * like PIN_RR or "rr:<cpus>" to give one of the cpus to each thread in turn.
+ */
+static int parse_rule(struct rule *rule, const char *str, size_t len)
+{
+	char *buffer = alloca(len + 1);
+	char *pattern, *target;
+
+	memcpy(buffer, str, len);
+	buffer[len] = '\0';
+
+	if ((target = strchr(buffer, '=')) == NULL)
+		return -1;
+	*target++ = '\0';
+
+	pattern = trim(buffer);
+	target = trim(target);
+	if (*pattern == '\0')
+		return -1;
+
+	if (strncmp(target, "rr:", 3) == 0)
+		rule->placement = build_cpu_round_robin(trim(target + 3));
+	else
+		rule->placement = build_round_robin(target);
+
+	if (rule->placement == NULL)
+		return -1;
+	if ((rule->pattern = strdup(pattern)) == NULL)
+		return -1;
+
+	return 0;
+}
+
+static struct ruleset *build_rules(const char *arg)
+{
+	struct ruleset *rules;
+	const char *ptr, *end;
+	size_t count = 1;
+
+	for (ptr=arg; *ptr != '\0'; ptr++)
+		if (*ptr == ';')
+			count++;
+
+	rules = inner_malloc(sizeof (*rules) + sizeof (struct rule) * count);
+	if (rules == NULL)
+		return NULL;
+
+	rules->count = 0;
+
+	while (1) {
+		end = strchrnul(arg, ';');
+
+		for (ptr=arg; ptr < end && isspace(*ptr); ptr++)
+			;
+		if (ptr < end) {
+			if (parse_rule(&rules->rules[rules->count], arg,
+				       end - arg) != 0)
+				return NULL;
+			rules->count++;
+		}
+
+		if (*end == '\0')
+			break;
+		arg = end + 1;
+	}
+
+	return rules;
+}
+
+int rules_active(void)
+{
+	return __atomic_load_n(&current_rules, __ATOMIC_RELAXED) != NULL;
+}
+
+/*
+ * The first rule matching any key of a thread gives its placement. Other
+ * threads use the current placement.
+ */
+static struct placement *select_placement(const struct thread_keys *keys)
+{
+	const char *values[4];
+	struct ruleset *rules;
+	const char *pattern;
+	size_t i, j;
+
+	rules = __atomic_load_n(&current_rules, __ATOMIC_ACQUIRE);
+	if (rules != NULL && keys != NULL) {
+		values[0] = keys->name;
+		values[1] = keys->symbol;
+		values[2] = keys->role;
+		values[3] = keys->group;
+
+		for (i=0; i<rules->count; i++) {
+			pattern = rules->rules[i].pattern;
+			for (j=0; j<4; j++)
+				if (values[j] != NULL && *values[j] != '\0'
+				    && fnmatch(pattern, values[j], 0) == 0)
+					return rules->rules[i].placement;
+		}
+	}
+
+	return __atomic_load_n(&current_placement, __ATOMIC_ACQUIRE);
+}
+
+static unsigned long masks_signature(const struct placement *placement)
+{
+	const unsigned char *ptr = (const unsigned char *) placement->masks;
+	size_t i, len = cpumask_size() * placement->total;
+	unsigned long hash = 14695981039346656037ul;
+
+	for (i=0; i<len; i++) {
+		hash ^= ptr[i];
+		hash *= 1099511628211ul;
+	}
+
+	return hash;
+}
+
+static void acquire_shared(const char *arg, const char *argname)
+{
+	struct placement *placement = current_placement;
+	int err;
+
+	if (placement == NULL || placement->total == 0) {
+		warning("ignore '%s' = '%s' without placement policy",
+			argname, arg);
+		return;
+	}
+
+	err = attach_shared(arg, placement->total,
+			    masks_signature(placement), &placement->cursor,
+			    &placement->occupancy, &placement->own_occupancy);
+	if (err != 0) {
+		warning("failed to attach '%s' = '%s', use private placement",
+			argname, arg);
+		return;
+	}
+
+	shared_placement = placement;
+}
+
+static void __attribute__((destructor)) release_shared(void)
+{
+	struct placement *placement = shared_placement;
+
+	if (placement == NULL)
+		return;
+
+	placement->cursor = &placement->next.value;
+	placement->occupancy = placement->local_occupancy;
+	placement->own_occupancy = NULL;
+	shared_placement = NULL;
+
+	detach_shared();
+}
+
+
+static const struct
+{
+	const char          *argname;
+	struct placement  *(*build)(const char *arg);
+} placement_sources[] = {
+	{ "PIN_RR",     build_round_robin },
+	{ "PIN_NUMA",   build_numa },
+	{ "PIN_POLICY", build_policy },
+	{ "PIN_GROUP",  build_group },
+	{ NULL, NULL }
+};
+
+static void publish_placement(struct placement *placement)
+{
+	__atomic_store_n(&current_placement, placement, __ATOMIC_RELEASE);
+}
+
+static void publish_mapping(struct mapping *mapping)
+{
+	__atomic_store_n(&current_mapping, mapping, __ATOMIC_RELEASE);
+	__atomic_store_n(&cpu_reverse_table,
+			 mapping ? mapping->reverse_table : NULL,
+			 __ATOMIC_RELEASE);
 }
 
+static int parse_skip(cpu_set_t *dest, const char *arg)
+{
+	size_t size = cpumask_size();
+	cpu_set_t *class = alloca(size);
+	char *buffer = alloca(strlen(arg) + 1);
+	char *word, *save;
+
+	strcpy(buffer, arg);
+
+	for (word = strtok_r(buffer, " ,", &save); word != NULL;
+	     word = strtok_r(NULL, " ,", &save)) {
+		if (read_cpu_class(class, word) != 0)
+			return -1;
+
+		CPU_AND_S(size, class, class, dest);
+		CPU_XOR_S(size, dest, dest, class);
+	}
+
+	return 0;
+}
+
+/*
+ * The allowed cpus are the cpus of the inherited affinity and of the cgroup
+ * cpuset, minus the cpus reserved by the kernel listed in PIN_SKIP.
+ */
+static void acquire_allowed(void)
+{
+	size_t i, size = cpumask_size();
+	cpu_set_t *allowed;
+	const char *arg;
+
+	if ((allowed = inner_malloc(size)) == NULL)
+		return;
+	if (read_allowed_cpus(allowed) != 0)
+		return;
+
+	arg = getenv("PIN_SKIP");
+	if (arg != NULL && parse_skip(allowed, arg) != 0)
+		error("failed to parse '%s' = '%s'", "PIN_SKIP", arg);
+
+	allowed_count = CPU_COUNT_S(size, allowed);
+	if ((allowed_list = inner_malloc(sizeof (int) * (allowed_count + 1)))
+	    == NULL)
+		return;
+
+	allowed_count = 0;
+	for (i=0; i < (size << 3); i++)
+		if (CPU_ISSET_S(i, size, allowed))
+			allowed_list[allowed_count++] = i;
+
+	allowed_cpus = allowed;
+
+	arg = getenv("PIN_RELATIVE");
+	relative_cpus = (arg != NULL && strcmp(arg, "0") != 0);
+}
 
 void acquire_arguments(void)
 {
-	char *arg;
+	const char *arg, *placement_argname = NULL;
+	struct placement *placement;
+	struct mapping *mapping;
+	struct ruleset *rules;
+	size_t i;
+
+	acquire_allowed();
 
 	arg = getenv("PIN_MAP");
-	if (arg != NULL)
-		acquire_map(arg, "PIN_MAP");
+	if (arg != NULL) {
+		if ((mapping = build_map(arg)) == NULL)
+			error("failed to parse '%s' = '%s'", "PIN_MAP", arg);
+		publish_mapping(mapping);
+	}
+
+	for (i=0; placement_sources[i].argname != NULL; i++) {
+		arg = getenv(placement_sources[i].argname);
+		if (arg == NULL)
+			continue;
 
-	arg = getenv("PIN_RR");
+		if (placement_argname != NULL) {
+			warning("ignore '%s' = '%s' in favor of '%s'",
+				placement_sources[i].argname, arg,
+				placement_argname);
+			continue;
+		}
+
+		placement = placement_sources[i].build(arg);
+		if (placement == NULL)
+			error("failed to parse '%s' = '%s'",
+			      placement_sources[i].argname, arg);
+
+		publish_placement(placement);
+		placement_argname = placement_sources[i].argname;
+	}
+
+	arg = getenv("PIN_SHARED");
 	if (arg != NULL)
-		acquire_round_robin(arg, "PIN_RR");
+		acquire_shared(arg, "PIN_SHARED");
+
+	arg = getenv("PIN_MEMPOLICY");
+	if (arg != NULL && acquire_mempolicy(arg) != 0)
+		error("failed to parse '%s' = '%s'", "PIN_MEMPOLICY", arg);
+
+	arg = getenv("PIN_RULES");
+	if (arg != NULL) {
+		if ((rules = build_rules(arg)) == NULL)
+			error("failed to parse '%s' = '%s'", "PIN_RULES", arg);
+		__atomic_store_n(&current_rules, rules, __ATOMIC_RELEASE);
+	}
+}
+
+/*
+ * Replace the mapping, the placement or the rules while the threads of the
+ * process keep running. An empty value removes the mapping, the placement or
+ * the rules. Placements installed this way always use a private occupancy.
+ */
+int reconfigure(const char *argname, const char *arg)
+{
+	struct placement *placement;
+	struct mapping *mapping = NULL;
+	struct ruleset *rules = NULL;
+	size_t i;
+
+	if (strcmp(argname, "PIN_RULES") == 0) {
+		if (*arg != '\0' && (rules = build_rules(arg)) == NULL)
+			return -1;
+		__atomic_store_n(&current_rules, rules, __ATOMIC_RELEASE);
+		return 0;
+	}
+
+	if (strcmp(argname, "PIN_MAP") == 0) {
+		if (*arg != '\0' && (mapping = build_map(arg)) == NULL)
+			return -1;
+		publish_mapping(mapping);
+		return 0;
+	}
+
+	for (i=0; placement_sources[i].argname != NULL; i++)
+		if (strcmp(argname, placement_sources[i].argname) == 0)
+			break;
+
+	if (placement_sources[i].argname == NULL)
+		return -1;
+
+	if (*arg == '\0') {
+		publish_placement(NULL);
+		return 0;
+	}
+
+	if ((placement = placement_sources[i].build(arg)) == NULL)
+		return -1;
+
+	publish_placement(placement);
+	return 0;
 }
 	
-const cpu_set_t *get_next_cpumask(void)
+/*
+ * Number of cursor positions a creating thread reserves at once. A batch
+ * covers whole rounds of a small table, so the threads of each creator are
+ * spread evenly over the masks by the cursor alone. The cursor of a shared
+ * placement advances one position at a time for the processes to interleave.
+ */
+static size_t cursor_batch(const struct placement *placement, size_t total)
+{
+	if (placement == shared_placement)
+		return 1;
+	if (total >= CURSOR_BATCH)
+		return CURSOR_BATCH;
+	return CURSOR_BATCH - CURSOR_BATCH % total;
+}
+
+static const cpu_set_t *take_cpumask(struct placement *placement,
+				     struct slot *slot)
 {
-	size_t id;
-	size_t old, new;
+	size_t id, i, idx, min, total, lead, batch;
+	size_t *occupancy;
 
-	if (total_masks == 0)
+	if (placement == NULL || placement->total <= placement->lead)
 		return NULL;
 
-	id = __sync_fetch_and_add(&next_mask, 1);
-	do {
-		old = next_mask;
-		if (old < total_masks)
-			break;
-		new = old % total_masks;
-	} while (__sync_bool_compare_and_swap(&next_mask, old, new));
+	lead = placement->lead;
+	total = placement->total - lead;
+	occupancy = placement->occupancy;
+
+	if (batch_left == 0 || batch_placement != placement) {
+		batch = cursor_batch(placement, total);
+		batch_next = __sync_fetch_and_add(placement->cursor, batch);
+		batch_left = batch;
+		batch_placement = placement;
+	}
+
+	id = batch_next++;
+	batch_left--;
 
-	if (id >= total_masks)
-		id = id % total_masks;
+	if (id >= lead) {
+		id = lead + (id - lead) % total;
 
-	return all_masks + id;
+		min = occupancy[id];
+		for (i=1; i<total && min > 0; i++) {
+			idx = lead + (id - lead + i) % total;
+			if (occupancy[idx] < min) {
+				min = occupancy[idx];
+				id = idx;
+			}
+		}
+	}
+
+	__sync_fetch_and_add(&occupancy[id], 1);
+	if (placement->own_occupancy != NULL)
+		__sync_fetch_and_add(&placement->own_occupancy[id], 1);
+
+	slot->placement = placement;
+	slot->index = id;
+	return cpumask_at(placement->masks, id);
 }
 
+const cpu_set_t *get_next_cpumask(struct slot *slot,
+				  const struct thread_keys *keys)
+{
+	return take_cpumask(select_placement(keys), slot);
+}
 
-static void map_cpuset(cpu_set_t *dest, const cpu_set_t *src, size_t len,
-			size_t *translate)
+/*
+ * Take the mask at the given index of the selected placement, as recorded by
+ * a previous run, or the next mask if the placement has no such index.
+ */
+const cpu_set_t *get_cpumask_at(struct slot *slot,
+				const struct thread_keys *keys, size_t index)
 {
-	size_t i, count = CPU_COUNT_S(len, src);
-	size_t size = len << 3;
+	struct placement *placement = select_placement(keys);
 
-	CPU_ZERO(dest);
+	if (placement == NULL || index >= placement->total)
+		return take_cpumask(placement, slot);
 
-	for (i=0; i<size && count; i++) {
-		if (count == 0)
-			break;
-		if (!CPU_ISSET_S(i, len, src))
-			continue;
+	__sync_fetch_and_add(&placement->occupancy[index], 1);
+	if (placement->own_occupancy != NULL)
+		__sync_fetch_and_add(&placement->own_occupancy[index], 1);
 
-		if (i < total_map)
-			CPU_SET_S(translate[i], len, dest);
-		else
-			CPU_SET_S(i, len, dest);
+	slot->placement = placement;
+	slot->index = index;
+	return cpumask_at(placement->masks, index);
+}
 
-		count--;
-	}
+void put_cpumask(const struct slot *slot)
+{
+	struct placement *placement = slot->placement;
+	size_t *own = placement->own_occupancy;
+
+	__sync_fetch_and_sub(&placement->occupancy[slot->index], 1);
+	if (own != NULL)
+		__sync_fetch_and_sub(&own[slot->index], 1);
+}
+
+/*
+ * Count again the slot of the thread a forked child inherits from its parent
+ * when the placement is shared, since the parent gives it back on its own.
+ */
+void adopt_cpumask(const struct slot *slot)
+{
+	struct placement *placement = slot->placement;
+
+	if (placement == NULL || placement != shared_placement)
+		return;
+
+	__sync_fetch_and_add(&placement->occupancy[slot->index], 1);
+	if (placement->own_occupancy != NULL)
+		__sync_fetch_and_add(&placement->own_occupancy[slot->index], 1);
+}
+
+/*
+ * Move a slot to another mask of the same placement.
+ */
+const cpu_set_t *move_cpumask(struct slot *slot, size_t index)
+{
+	struct placement *placement = slot->placement;
+
+	put_cpumask(slot);
+
+	__sync_fetch_and_add(&placement->occupancy[index], 1);
+	if (placement->own_occupancy != NULL)
+		__sync_fetch_and_add(&placement->own_occupancy[index], 1);
+
+	slot->index = index;
+	return cpumask_at(placement->masks, index);
+}
+
+size_t placement_size(const struct placement *placement)
+{
+	return placement->total;
+}
+
+size_t placement_lead(const struct placement *placement)
+{
+	return placement->lead;
+}
+
+const struct schedule *slot_schedule(const struct slot *slot)
+{
+	const struct schedule *schedules = slot->placement->schedules;
+
+	if (schedules == NULL || schedules[slot->index].policy < 0)
+		return NULL;
+	return &schedules[slot->index];
+}
+
+static void gather_cpumasks(cpu_set_t *dest,
+			    const struct placement *placement)
+{
+	size_t i, size = cpumask_size();
+
+	if (placement == NULL)
+		return;
+	for (i=0; i<placement->total; i++)
+		CPU_OR_S(size, dest, dest, cpumask_at(placement->masks, i));
+}
+
+/*
+ * Store in dest the cpus the current placement and rules pin threads on, in
+ * the numbering of PIN_MAP, and return how many they are. Return 0 when no
+ * placement pins the threads.
+ */
+size_t placement_cpus(cpu_set_t *dest)
+{
+	size_t i, size = cpumask_size();
+	struct ruleset *rules;
+	cpu_set_t *set;
+
+	set = alloca(size);
+	CPU_ZERO_S(size, set);
+
+	gather_cpumasks(set, __atomic_load_n(&current_placement,
+					     __ATOMIC_ACQUIRE));
+
+	rules = __atomic_load_n(&current_rules, __ATOMIC_ACQUIRE);
+	if (rules != NULL)
+		for (i=0; i<rules->count; i++)
+			gather_cpumasks(set, rules->rules[i].placement);
+
+	map_cpuset_reverse(dest, set, size);
+	return CPU_COUNT_S(size, dest);
+}
+
+/*
+ * Return the mask to use for a registered thread, and move its slot to
+ * another placement if the thread should not use its current one anymore.
+ */
+const cpu_set_t *refresh_cpumask(struct thread_record *record)
+{
+	struct thread_keys keys = {
+		record->name, record->symbol, record->role, record->group
+	};
+	struct placement *placement;
+
+	placement = select_placement(&keys);
+	if (record->set != NULL && record->slot.placement == placement)
+		return record->set;
+	if (record->set == NULL && placement == NULL)
+		return NULL;
+
+	if (record->set != NULL)
+		put_cpumask(&record->slot);
+	return take_cpumask(placement, &record->slot);
+}
+
+
+static void map_cpuset(cpu_set_t *dest, const cpu_set_t *src, size_t len,
+			int forward)
+{
+	struct mapping *mapping;
+
+	mapping = __atomic_load_n(&current_mapping, __ATOMIC_ACQUIRE);
+	if (mapping == NULL)
+		memcpy(dest, src, len);
+	else
+		translate_cpuset(dest, src, len, forward
+				 ? &mapping->cpumap_forward
+				 : &mapping->cpumap_reverse);
 }
 
 void map_cpuset_forward(cpu_set_t *dest, const cpu_set_t *src, size_t len)
 {
-	map_cpuset(dest, src, len, map_forward);
+	map_cpuset(dest, src, len, 1);
 }
 
 void map_cpuset_reverse(cpu_set_t *dest, const cpu_set_t *src, size_t len)
 {
-	map_cpuset(dest, src, len, map_reverse);
+	map_cpuset(dest, src, len, 0);
 }
 
-int map_cpu_reverse(int cpu)
+int map_cpu_forward(int cpu)
 {
-	if (cpu < 0)
+	struct mapping *mapping;
+
+	mapping = __atomic_load_n(&current_mapping, __ATOMIC_ACQUIRE);
+	if (cpu < 0 || mapping == NULL)
 		return cpu;
-	if ((size_t) cpu >= total_map)
+	if ((size_t) cpu >= mapping->total)
 		return cpu;
-	return map_reverse[cpu];
+	return mapping->forward[cpu];
 }
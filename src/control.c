@@ -0,0 +1,203 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <pin.h>
+#include <pattern.h>
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+#define CONTROL_BACKLOG  8
+
+
+static struct sockaddr_un  control_address;
+static pid_t               control_owner = 0;
+
+
+static int bind_control(int fd)
+{
+	int err, probe;
+
+	if (bind(fd, (struct sockaddr *) &control_address,
+		 sizeof (control_address)) == 0)
+		return 0;
+	if (errno != EADDRINUSE)
+		return -1;
+
+	/*
+	 * The socket file may be left by a dead process. Only remove it if
+	 * nobody accepts connections on it anymore.
+	 */
+	if ((probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+		return -1;
+	err = connect(probe, (struct sockaddr *) &control_address,
+		      sizeof (control_address));
+	close(probe);
+
+	if (err == 0 || errno != ECONNREFUSED) {
+		errno = EADDRINUSE;
+		return -1;
+	}
+
+	unlink(control_address.sun_path);
+	return bind(fd, (struct sockaddr *) &control_address,
+		    sizeof (control_address));
+}
+
+int open_control(const char *pattern)
+{
+	int fd;
+
+	memset(&control_address, 0, sizeof (control_address));
+	control_address.sun_family = AF_UNIX;
+
+	if (expand_pattern(control_address.sun_path,
+			   sizeof (control_address.sun_path), pattern,
+			   getpid()) != 0) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+		return -1;
+
+	if (bind_control(fd) != 0)
+		goto err;
+
+	control_owner = getpid();
+
+	if (listen(fd, CONTROL_BACKLOG) != 0)
+		goto err;
+
+	return fd;
+ err:
+	close(fd);
+	return -1;
+}
+
+static void __attribute__((destructor)) close_control(void)
+{
+	if (control_owner == 0 || control_owner != getpid())
+		return;
+
+	unlink(control_address.sun_path);
+	control_owner = 0;
+}
+
+
+/*
+ * Replies are sent without SIGPIPE so a client leaving early cannot kill the
+ * process.
+ */
+static void reply(int fd, const char *format, ...)
+{
+	char buffer[512];
+	va_list ap;
+	int len;
+
+	va_start(ap, format);
+	len = vsnprintf(buffer, sizeof (buffer), format, ap);
+	va_end(ap);
+
+	if (len < 0)
+		return;
+	if ((size_t) len >= sizeof (buffer))
+		len = sizeof (buffer) - 1;
+
+	send(fd, buffer, len, MSG_NOSIGNAL);
+}
+
+/*
+ * A request is a line "<variable>=<value>" where variable is one of PIN_MAP,
+ * PIN_RR, PIN_NUMA, PIN_POLICY, PIN_GROUP or PIN_RULES. The new value replaces
+ * the current one and every pinned thread is moved to the new placement before
+ * to answer "ok".
+ */
+static void handle_request(int out, char *line)
+{
+	size_t len = strlen(line);
+	char *value;
+
+	while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+		line[--len] = '\0';
+	if (len == 0)
+		return;
+
+	if ((value = strchr(line, '=')) == NULL) {
+		reply(out, "error: invalid request '%s'\n", line);
+		return;
+	}
+
+	*value++ = '\0';
+
+	if (reconfigure(line, value) != 0) {
+		reply(out, "error: failed to parse '%s' = '%s'\n", line,
+			value);
+		return;
+	}
+
+	repin_threads();
+	reply(out, "ok\n");
+}
+
+static void handle_connection(int fd)
+{
+	char *line = NULL;
+	size_t len = 0;
+	FILE *stream;
+
+	if ((stream = fdopen(fd, "r")) == NULL) {
+		close(fd);
+		return;
+	}
+
+	while (getline(&line, &len, stream) >= 0)
+		handle_request(fd, line);
+
+	free(line);
+	fclose(stream);
+}
+
+void *serve_control(void *arg)
+{
+	int fd, listener = (int) (long) arg;
+
+	while (1) {
+		fd = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			warning("control socket failed");
+			break;
+		}
+
+		handle_connection(fd);
+	}
+
+	close(listener);
+	return NULL;
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <pin.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+
+#define WORD_BYTES   (sizeof (unsigned long))
+#define WORD_BITS    (WORD_BYTES << 3)
+#define GROUP_BITS   8
+#define GROUP_MASK   ((1ul << GROUP_BITS) - 1)
+#define GROUP_VALUES (1 << GROUP_BITS)
+
+
+/*
+ * A cpu mapping is compiled into two parts. The first part is, for each word
+ * of the input mask, the bits of the cpus which are mapped on themselves.
+ * These bits are translated word by word with a mask. The second part is, for
+ * each group of 8 cpus, how to translate the cpus which move: when all of them
+ * land in the same output group, a 256 entries table gives the output bits,
+ * otherwise the destination of each cpu is looked up bit by bit.
+ */
+struct cpumap_group
+{
+	unsigned char   moved;
+	size_t          target;
+	unsigned char  *table;
+	size_t          cpus[GROUP_BITS];
+};
+
+
+static int compile_group(struct cpumap_group *group)
+{
+	unsigned int value, bit;
+	size_t target = (size_t) -1;
+
+	for (bit=0; bit < GROUP_BITS; bit++) {
+		if (!(group->moved & (1 << bit)))
+			continue;
+		if (target == (size_t) -1)
+			target = group->cpus[bit] / GROUP_BITS;
+		else if (target != group->cpus[bit] / GROUP_BITS)
+			return 0;
+	}
+
+	if ((group->table = calloc(GROUP_VALUES, 1)) == NULL)
+		return -1;
+	group->target = target;
+
+	for (value=0; value < GROUP_VALUES; value++)
+		for (bit=0; bit < GROUP_BITS; bit++)
+			if (value & group->moved & (1 << bit))
+				group->table[value] |= 1 << (group->cpus[bit]
+							     % GROUP_BITS);
+
+	return 0;
+}
+
+int compile_cpumap(struct cpumap *dest, const size_t *translate, size_t len)
+{
+	size_t words = (len + WORD_BITS - 1) / WORD_BITS;
+	struct cpumap_group *group;
+	size_t cpu, to;
+
+	dest->words = words;
+	dest->keep = calloc(words, WORD_BYTES);
+	dest->groups = calloc(words * WORD_BYTES, sizeof (*dest->groups));
+
+	if (dest->keep == NULL || dest->groups == NULL)
+		return -1;
+
+	for (cpu=0; cpu < words * WORD_BITS; cpu++) {
+		to = (cpu < len) ? translate[cpu] : cpu;
+
+		if (to == cpu) {
+			dest->keep[cpu / WORD_BITS] |= 1ul << (cpu % WORD_BITS);
+			continue;
+		}
+
+		group = dest->groups + cpu / GROUP_BITS;
+		group->moved |= 1 << (cpu % GROUP_BITS);
+		group->cpus[cpu % GROUP_BITS] = to;
+	}
+
+	for (cpu=0; cpu < words * WORD_BYTES; cpu++)
+		if (dest->groups[cpu].moved != 0
+		    && compile_group(dest->groups + cpu) != 0)
+			return -1;
+
+	return 0;
+}
+
+
+static inline void set_word_bit(unsigned long *words, size_t len, size_t cpu)
+{
+	if (cpu / WORD_BITS < len)
+		words[cpu / WORD_BITS] |= 1ul << (cpu % WORD_BITS);
+}
+
+static void translate_group(unsigned long *out, size_t len,
+			    const struct cpumap_group *group,
+			    unsigned long value)
+{
+	size_t bit;
+
+	if (group->table != NULL) {
+		if (group->target / WORD_BYTES < len)
+			out[group->target / WORD_BYTES] |=
+				(unsigned long) group->table[value]
+				<< ((group->target % WORD_BYTES) * GROUP_BITS);
+		return;
+	}
+
+	while (value != 0) {
+		bit = __builtin_ctzl(value);
+		set_word_bit(out, len, group->cpus[bit]);
+		value &= value - 1;
+	}
+}
+
+static void translate_words(unsigned long *out, const unsigned long *in,
+			    size_t words, const struct cpumap *map)
+{
+	size_t w, group, covered = (words < map->words) ? words : map->words;
+	unsigned long moved;
+
+	for (w=0; w < covered; w++)
+		out[w] = in[w] & map->keep[w];
+	memcpy(out + covered, in + covered, (words - covered) * WORD_BYTES);
+
+	for (w=0; w < covered; w++) {
+		moved = in[w] & ~map->keep[w];
+
+		while (moved != 0) {
+			group = __builtin_ctzl(moved) / GROUP_BITS;
+			translate_group(out, words,
+					map->groups + w * WORD_BYTES + group,
+					(moved >> (group * GROUP_BITS))
+					& GROUP_MASK);
+			moved &= ~(GROUP_MASK << (group * GROUP_BITS));
+		}
+	}
+}
+
+/*
+ * A mask whose size is not a whole number of words, like the 4 bytes accepted
+ * by sched_setaffinity(), is translated in a zero padded copy.
+ */
+void translate_cpuset(cpu_set_t *dest, const cpu_set_t *src, size_t len,
+		      const struct cpumap *map)
+{
+	size_t words = (len + WORD_BYTES - 1) / WORD_BYTES;
+	unsigned long *in, *out;
+
+	if (len % WORD_BYTES == 0) {
+		translate_words((unsigned long *) dest,
+				(const unsigned long *) src, words, map);
+		return;
+	}
+
+	in = alloca(words * WORD_BYTES);
+	out = alloca(words * WORD_BYTES);
+	in[words - 1] = 0;
+	memcpy(in, src, len);
+
+	translate_words(out, in, words, map);
+	memcpy(dest, out, len);
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <pin.h>
+#include <libpin.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define GROUP_PREFIX  "group:"
+
+
+struct group
+{
+	struct group  *next;
+	char           tag[];
+};
+
+
+static const char *const role_tags[] = {
+	[PIN_ROLE_DEFAULT]    = NULL,
+	[PIN_ROLE_LATENCY]    = "role:latency",
+	[PIN_ROLE_THROUGHPUT] = "role:throughput",
+	[PIN_ROLE_BACKGROUND] = "role:background",
+};
+
+static struct group  *groups = NULL;
+static int            groups_lock = 0;
+
+
+int role_tag(int role, const char **tag)
+{
+	if (role < 0
+	    || (size_t) role >= sizeof (role_tags) / sizeof (*role_tags))
+		return -1;
+
+	*tag = role_tags[role];
+	return 0;
+}
+
+/*
+ * Group tags are kept for the lifetime of the process since the threads of a
+ * group may outlive it, so each group name is only stored once.
+ */
+const char *group_tag(const char *name)
+{
+	size_t len = strlen(GROUP_PREFIX) + strlen(name) + 1;
+	struct group *group;
+
+	while (__atomic_exchange_n(&groups_lock, 1, __ATOMIC_ACQUIRE))
+		;
+
+	for (group = groups; group != NULL; group = group->next)
+		if (strcmp(group->tag + strlen(GROUP_PREFIX), name) == 0)
+			break;
+
+	if (group == NULL && (group = malloc(sizeof (*group) + len)) != NULL) {
+		snprintf(group->tag, len, GROUP_PREFIX "%s", name);
+		group->next = groups;
+		groups = group;
+	}
+
+	__atomic_store_n(&groups_lock, 0, __ATOMIC_RELEASE);
+
+	return (group != NULL) ? group->tag : NULL;
+}
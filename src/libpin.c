@@ -0,0 +1,186 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <pin.h>
+#include <libpin.h>
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+
+
+/*
+ * The libpin library, for the programs which are not run under pin.so. Each
+ * function first looks for the same function in the libraries loaded after
+ * it: when pin.so is preloaded, a program statically linked with libpin.a
+ * uses the functions of pin.so instead. Otherwise, the calling thread is
+ * placed by libpin itself, the first time it calls pin_hint().
+ */
+
+struct placed_thread
+{
+	const cpu_set_t  *set;
+	struct slot       slot;
+	struct schedule   original;
+};
+
+
+static pthread_once_t  acquire_once = PTHREAD_ONCE_INIT;
+static pthread_key_t   release_key;
+
+static __thread struct placed_thread  current_thread = {
+	NULL, { NULL, 0 }, { -1, 0 }
+};
+static __thread const char           *current_role = NULL;
+static __thread const char           *current_group = NULL;
+
+
+#define forward(function) \
+	((__typeof__(&function)) dlsym(RTLD_NEXT, #function))
+
+
+static void release_thread(void *unused __attribute__((unused)))
+{
+	if (current_thread.set != NULL)
+		put_cpumask(&current_thread.slot);
+	current_thread.set = NULL;
+}
+
+static void adopt_thread(void)
+{
+	if (current_thread.set != NULL)
+		adopt_cpumask(&current_thread.slot);
+}
+
+static void acquire(void)
+{
+	acquire_arguments();
+	pthread_key_create(&release_key, release_thread);
+	pthread_atfork(NULL, NULL, adopt_thread);
+}
+
+static void place_current(void)
+{
+	struct thread_keys keys = { NULL, NULL, current_role, current_group };
+	char name[THREAD_NAME_LEN];
+	const cpu_set_t *set;
+
+	pthread_once(&acquire_once, acquire);
+
+	prctl(PR_GET_NAME, name);
+	keys.name = name;
+
+	release_thread(NULL);
+	set = get_next_cpumask(&current_thread.slot, &keys);
+	if (set != NULL) {
+		sched_setaffinity(0, cpumask_size(), set);
+		apply_schedule(0, slot_schedule(&current_thread.slot),
+			       &current_thread.original);
+		pthread_setspecific(release_key, &current_thread);
+	} else {
+		apply_schedule(0, NULL, &current_thread.original);
+	}
+	current_thread.set = set;
+}
+
+
+int pin_hint(int role)
+{
+	int (*next)(int) = forward(pin_hint);
+	const char *tag;
+
+	if (next != NULL)
+		return next(role);
+
+	if (role_tag(role, &tag) != 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	current_role = tag;
+	place_current();
+	return 0;
+}
+
+int pin_group_begin(const char *name)
+{
+	int (*next)(const char *) = forward(pin_group_begin);
+	const char *tag;
+
+	if (next != NULL)
+		return next(name);
+
+	if (name == NULL || *name == '\0') {
+		errno = EINVAL;
+		return -1;
+	}
+	if ((tag = group_tag(name)) == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	current_group = tag;
+	return 0;
+}
+
+int pin_group_end(void)
+{
+	int (*next)(void) = forward(pin_group_end);
+
+	if (next != NULL)
+		return next();
+
+	if (current_group == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	current_group = NULL;
+	return 0;
+}
+
+int pin_current_mask(size_t size, cpu_set_t *mask)
+{
+	int (*next)(size_t, cpu_set_t *) = forward(pin_current_mask);
+	size_t len = cpumask_size();
+	cpu_set_t *set, *mapped;
+
+	if (next != NULL)
+		return next(size, mask);
+
+	if (current_thread.set == NULL) {
+		errno = ESRCH;
+		return -1;
+	}
+
+	if (len < size)
+		len = size;
+	set = alloca(len);
+	mapped = alloca(len);
+	memset(set, 0, len);
+	memcpy(set, current_thread.set, cpumask_size());
+
+	map_cpuset_reverse(mapped, set, len);
+	memcpy(mask, mapped, size);
+	return 0;
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <pin.h>
+#include <pattern.h>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+#define ENTRIES_CHUNK  64
+
+
+/*
+ * A thread is identified by the path of creation ordinals from the main
+ * thread, like "0.2.1" for the second thread created by the third thread
+ * created by the main thread, and by the symbol of its start routine.
+ */
+struct manifest_entry
+{
+	char    identity[IDENTITY_LEN];
+	char    symbol[IDENTITY_LEN];
+	size_t  index;
+};
+
+
+static int                     record_fd = -1;
+static struct manifest_entry  *replay_entries = NULL;
+static size_t                  replay_count = 0;
+static int                     replay_warned = 0;
+
+
+/*
+ * The threads of a forked child have the same identities as the threads of
+ * their parent, so the child does not record.
+ */
+static void stop_record(void)
+{
+	record_fd = -1;
+}
+
+int open_record(const char *pattern)
+{
+	char path[PATH_MAX];
+
+	if (expand_pattern(path, sizeof (path), pattern, getpid()))
+		return -1;
+
+	record_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND
+			 | O_CLOEXEC, 0644);
+	if (record_fd < 0)
+		return -1;
+
+	pthread_atfork(NULL, NULL, stop_record);
+	return 0;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+	const struct manifest_entry *ea = a, *eb = b;
+
+	return strcmp(ea->identity, eb->identity);
+}
+
+static int compare_identity(const void *key, const void *elem)
+{
+	const struct manifest_entry *entry = elem;
+
+	return strcmp(key, entry->identity);
+}
+
+int open_replay(const char *path)
+{
+	struct manifest_entry *entries = NULL, *tmp, *entry;
+	size_t count = 0, capacity = 0;
+	char *line = NULL;
+	size_t len = 0;
+	FILE *file;
+
+	if ((file = fopen(path, "r")) == NULL)
+		return -1;
+
+	while (getline(&line, &len, file) > 0) {
+		if (count == capacity) {
+			capacity += ENTRIES_CHUNK;
+			tmp = realloc(entries, sizeof (*entries) * capacity);
+			if (tmp == NULL)
+				goto err;
+			entries = tmp;
+		}
+
+		entry = &entries[count];
+		if (sscanf(line, "%127s %127s %zu", entry->identity,
+			   entry->symbol, &entry->index) != 3)
+			goto err;
+		count++;
+	}
+
+	free(line);
+	fclose(file);
+
+	qsort(entries, count, sizeof (*entries), compare_entries);
+
+	replay_entries = entries;
+	replay_count = count;
+	return 0;
+ err:
+	free(line);
+	free(entries);
+	fclose(file);
+	return -1;
+}
+
+int manifest_active(void)
+{
+	return record_fd >= 0 || replay_entries != NULL;
+}
+
+/*
+ * Find the index of the mask recorded for a thread. A thread which starts
+ * another routine than the recorded one is not replayed.
+ */
+int replay_placement(const char *identity, const char *symbol,
+		     size_t *index)
+{
+	struct manifest_entry *entry;
+
+	if (replay_entries == NULL || *identity == '\0')
+		return -1;
+
+	entry = bsearch(identity, replay_entries, replay_count,
+			sizeof (*replay_entries), compare_identity);
+	if (entry == NULL)
+		return -1;
+
+	if (symbol == NULL)
+		symbol = "-";
+
+	/* long symbols are truncated in the manifest */
+	if (strncmp(entry->symbol, symbol, IDENTITY_LEN - 1) != 0) {
+		if (!__atomic_exchange_n(&replay_warned, 1, __ATOMIC_RELAXED))
+			warning("thread %s starts '%s' instead of '%s'",
+				identity, symbol, entry->symbol);
+		return -1;
+	}
+
+	*index = entry->index;
+	return 0;
+}
+
+void record_placement(const char *identity, const char *symbol,
+		      size_t index)
+{
+	char line[2 * IDENTITY_LEN + 32];
+	int len;
+
+	if (record_fd < 0 || *identity == '\0')
+		return;
+
+	len = snprintf(line, sizeof (line), "%s %.127s %zu\n", identity,
+		       (symbol != NULL) ? symbol : "-", index);
+	if (len > 0 && (size_t) len < sizeof (line))
+		if (write(record_fd, line, len) != len)
+			warning("failed to record thread %s", identity);
+}
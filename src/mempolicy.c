@@ -0,0 +1,108 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <pin.h>
+
+#include <linux/mempolicy.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+#define BITS_PER_LONG  (sizeof (unsigned long) << 3)
+
+
+static int                mempolicy_mode = -1;
+static struct numa_node  *mempolicy_nodes;
+static size_t             mempolicy_count;
+static size_t             mempolicy_bits;    /* highest node id + 1 */
+static int                mempolicy_warned = 0;
+
+
+int acquire_mempolicy(const char *arg)
+{
+	ssize_t count;
+
+	if (strcmp(arg, "bind") == 0)
+		mempolicy_mode = MPOL_BIND;
+	else if (strcmp(arg, "preferred") == 0)
+		mempolicy_mode = MPOL_PREFERRED;
+	else if (strcmp(arg, "interleave") == 0)
+		mempolicy_mode = MPOL_INTERLEAVE;
+	else
+		return -1;
+
+	if ((count = read_numa_nodes(&mempolicy_nodes)) <= 0) {
+		mempolicy_mode = -1;
+		return -1;
+	}
+
+	mempolicy_count = count;
+	mempolicy_bits = mempolicy_nodes[count - 1].id + 1;
+
+	return 0;
+}
+
+/*
+ * Apply the memory policy to the calling thread, over the nodes whose cpus
+ * intersect the given mask. A preferred policy only uses the first of these
+ * nodes.
+ * Only the thread itself can set its policy: a thread moved by another one
+ * applies it again on its next call to pin.so, and a thread unpinned keeps the
+ * policy of its last mask. Pages already allocated are not migrated.
+ */
+void apply_mempolicy(const cpu_set_t *set)
+{
+	size_t i, words, size = cpumask_size();
+	cpu_set_t *common;
+	unsigned long *nodemask;
+	int found = 0, id;
+
+	if (mempolicy_mode < 0 || set == NULL)
+		return;
+
+	words = (mempolicy_bits + BITS_PER_LONG - 1) / BITS_PER_LONG;
+	nodemask = alloca(words * sizeof (unsigned long));
+	common = alloca(size);
+	memset(nodemask, 0, words * sizeof (unsigned long));
+
+	for (i=0; i<mempolicy_count; i++) {
+		CPU_AND_S(size, common, set, mempolicy_nodes[i].cpus);
+		if (CPU_COUNT_S(size, common) == 0)
+			continue;
+
+		id = mempolicy_nodes[i].id;
+		nodemask[id / BITS_PER_LONG] |= 1ul << (id % BITS_PER_LONG);
+		found = 1;
+
+		if (mempolicy_mode == MPOL_PREFERRED)
+			break;
+	}
+
+	if (!found)
+		return;
+
+	if (syscall(SYS_set_mempolicy, mempolicy_mode, nodemask,
+		    mempolicy_bits + 1) != 0 && !mempolicy_warned) {
+		mempolicy_warned = 1;
+		warning("failed to apply memory policy");
+	}
+}
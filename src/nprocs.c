@@ -0,0 +1,461 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <pin.h>
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/sysinfo.h>
+#include <unistd.h>
+
+
+#define CPUINFO_PATH      "/proc/cpuinfo"
+#define CPU_ONLINE_PATH   "/sys/devices/system/cpu/online"
+#define CPU_POSSIBLE_PATH "/sys/devices/system/cpu/possible"
+
+#define CPUINFO_KEY       "processor"
+#define CPUINFO_CHUNK     65536
+
+
+struct cpuinfo_block
+{
+	int          cpu;      /* cpu number, in the numbering of PIN_MAP */
+	const char  *body;     /* the block without its processor line */
+	size_t       len;
+};
+
+
+static int    nprocs_enabled = 0;
+
+/*
+ * These functions can be called by other libraries before pin.so is
+ * initialized, so the original functions are looked up on first use.
+ */
+static void  *next_sysconf = NULL;
+static void  *next_get_nprocs = NULL;
+static void  *next_get_nprocs_conf = NULL;
+static void  *next_open = NULL;
+static void  *next_open64 = NULL;
+static void  *next___open_2 = NULL;
+static void  *next___open64_2 = NULL;
+static void  *next_openat = NULL;
+static void  *next_openat64 = NULL;
+static void  *next___openat_2 = NULL;
+static void  *next___openat64_2 = NULL;
+static void  *next_fopen = NULL;
+static void  *next_fopen64 = NULL;
+
+
+static void *lookup(void **next, const char *name)
+{
+	void *function = __atomic_load_n(next, __ATOMIC_RELAXED);
+
+	if (function == NULL) {
+		function = dlsym(RTLD_NEXT, name);
+		__atomic_store_n(next, function, __ATOMIC_RELAXED);
+	}
+
+	return function;
+}
+
+#define original(function) \
+	((__typeof__(&function)) lookup(&next_##function, #function))
+
+
+void acquire_nprocs(const char *arg)
+{
+	nprocs_enabled = (arg != NULL && strcmp(arg, "0") != 0);
+}
+
+/*
+ * Return the number of cpus to report, or 0 if the calls should not be
+ * altered.
+ */
+static size_t reported_count(void)
+{
+	cpu_set_t *set;
+
+	if (!nprocs_enabled)
+		return 0;
+
+	set = alloca(cpumask_size());
+	return placement_cpus(set);
+}
+
+static int is_cpu_file(const char *path, int flags)
+{
+	if (!nprocs_enabled || (flags & O_ACCMODE) != O_RDONLY)
+		return 0;
+	return (strcmp(path, CPUINFO_PATH) == 0
+		|| strcmp(path, CPU_ONLINE_PATH) == 0
+		|| strcmp(path, CPU_POSSIBLE_PATH) == 0);
+}
+
+
+static char *read_whole(const char *path, size_t *len)
+{
+	size_t done = 0, size = 0;
+	char *buffer = NULL, *tmp;
+	ssize_t ret;
+	int fd;
+
+	if ((fd = original(open)(path, O_RDONLY | O_CLOEXEC)) < 0)
+		return NULL;
+
+	do {
+		if (done == size) {
+			size += CPUINFO_CHUNK;
+			if ((tmp = realloc(buffer, size)) == NULL) {
+				free(buffer);
+				close(fd);
+				return NULL;
+			}
+			buffer = tmp;
+		}
+		ret = read(fd, buffer + done, size - done);
+		if (ret > 0)
+			done += ret;
+	} while (ret > 0);
+
+	close(fd);
+
+	if (ret < 0) {
+		free(buffer);
+		return NULL;
+	}
+
+	*len = done;
+	return buffer;
+}
+
+static int compare_blocks(const void *a, const void *b)
+{
+	const struct cpuinfo_block *ba = a, *bb = b;
+
+	return ba->cpu - bb->cpu;
+}
+
+/*
+ * Keep the blocks of /proc/cpuinfo describing the reported cpus, renumbered
+ * and sorted in the numbering of PIN_MAP.
+ */
+static int write_cpuinfo(int fd, const cpu_set_t *set, size_t count)
+{
+	size_t i, len, found = 0, size = cpumask_size();
+	struct cpuinfo_block *blocks;
+	char *content, *ptr, *next, *end, header[32];
+	cpu_set_t *seen;
+	long cpu;
+	int vcpu, err = -1;
+
+	if ((content = read_whole(CPUINFO_PATH, &len)) == NULL)
+		return -1;
+	if ((blocks = malloc(count * sizeof (*blocks))) == NULL)
+		goto out;
+
+	seen = alloca(size);
+	CPU_ZERO_S(size, seen);
+	end = content + len;
+
+	ptr = content;
+	while (ptr < end && found < count) {
+		next = ptr;
+		do {
+			next = memchr(next, '\n', end - next);
+			next = (next == NULL) ? end : next + 1;
+		} while (next < end && strncmp(next, CPUINFO_KEY,
+					       strlen(CPUINFO_KEY)) != 0);
+
+		if (strncmp(ptr, CPUINFO_KEY, strlen(CPUINFO_KEY)) != 0
+		    || (ptr = memchr(ptr, ':', next - ptr)) == NULL) {
+			ptr = next;
+			continue;
+		}
+
+		cpu = strtol(ptr + 1, &ptr, 10);
+		if (cpu < 0 || (size_t) cpu >= (size << 3)) {
+			ptr = next;
+			continue;
+		}
+
+		vcpu = map_cpu_reverse(cpu);
+		if (CPU_ISSET_S(vcpu, size, set)
+		    && !CPU_ISSET_S(vcpu, size, seen)) {
+			CPU_SET_S(vcpu, size, seen);
+			blocks[found].cpu = vcpu;
+			blocks[found].body = ptr;
+			blocks[found].len = next - ptr;
+			found++;
+		}
+
+		ptr = next;
+	}
+
+	qsort(blocks, found, sizeof (*blocks), compare_blocks);
+
+	for (i=0; i<found; i++) {
+		len = snprintf(header, sizeof (header), CPUINFO_KEY "\t: %d",
+			       blocks[i].cpu);
+		if (write(fd, header, len) != (ssize_t) len)
+			goto out;
+		len = blocks[i].len;
+		if (write(fd, blocks[i].body, len) != (ssize_t) len)
+			goto out;
+	}
+
+	err = 0;
+ out:
+	free(blocks);
+	free(content);
+	return err;
+}
+
+static int write_cpulist(int fd, const cpu_set_t *set, size_t count)
+{
+	size_t cpu, first, size = cpumask_size();
+	char buffer[32];
+	int len;
+
+	for (cpu=0; count > 0; cpu++) {
+		if (!CPU_ISSET_S(cpu, size, set))
+			continue;
+
+		first = cpu;
+		while (CPU_ISSET_S(cpu + 1, size, set))
+			cpu++;
+		count -= cpu - first + 1;
+
+		if (cpu == first)
+			len = snprintf(buffer, sizeof (buffer), "%zu%s", first,
+				       count > 0 ? "," : "\n");
+		else
+			len = snprintf(buffer, sizeof (buffer), "%zu-%zu%s",
+				       first, cpu, count > 0 ? "," : "\n");
+
+		if (write(fd, buffer, len) != len)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Return a file descriptor on an anonymous file holding the faked content, or
+ * -2 if the path should be opened normally.
+ */
+static int open_cpu_file(const char *path, int flags)
+{
+	size_t count, size = cpumask_size();
+	cpu_set_t *set = alloca(size);
+	int fd, ret, saved;
+
+	if ((count = placement_cpus(set)) == 0)
+		return -2;
+
+	fd = memfd_create("pin", (flags & O_CLOEXEC) ? MFD_CLOEXEC : 0);
+	if (fd < 0)
+		return -2;
+
+	if (strcmp(path, CPUINFO_PATH) == 0)
+		ret = write_cpuinfo(fd, set, count);
+	else
+		ret = write_cpulist(fd, set, count);
+
+	if (ret != 0 || lseek(fd, 0, SEEK_SET) != 0) {
+		saved = errno;
+		close(fd);
+		errno = saved;
+		return -1;
+	}
+
+	return fd;
+}
+
+static int fopen_flags(const char *mode)
+{
+	int flags = O_RDONLY;
+
+	if (*mode != 'r' || strchr(mode, '+') != NULL)
+		flags = O_RDWR;
+	if (strchr(mode, 'e') != NULL)
+		flags |= O_CLOEXEC;
+
+	return flags;
+}
+
+
+long sysconf(int name)
+{
+	size_t count;
+
+	if ((name == _SC_NPROCESSORS_ONLN || name == _SC_NPROCESSORS_CONF)
+	    && (count = reported_count()) > 0)
+		return count;
+	return original(sysconf)(name);
+}
+
+int get_nprocs(void)
+{
+	size_t count;
+
+	if ((count = reported_count()) > 0)
+		return count;
+	return original(get_nprocs)();
+}
+
+int get_nprocs_conf(void)
+{
+	size_t count;
+
+	if ((count = reported_count()) > 0)
+		return count;
+	return original(get_nprocs_conf)();
+}
+
+static mode_t open_mode(int flags, va_list ap)
+{
+	if ((flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE)
+		return va_arg(ap, mode_t);
+	return 0;
+}
+
+int open(const char *path, int flags, ...)
+{
+	mode_t mode;
+	va_list ap;
+	int fd;
+
+	va_start(ap, flags);
+	mode = open_mode(flags, ap);
+	va_end(ap);
+
+	if (is_cpu_file(path, flags) && (fd = open_cpu_file(path, flags)) != -2)
+		return fd;
+	return original(open)(path, flags, mode);
+}
+
+int open64(const char *path, int flags, ...)
+{
+	mode_t mode;
+	va_list ap;
+	int fd;
+
+	va_start(ap, flags);
+	mode = open_mode(flags, ap);
+	va_end(ap);
+
+	if (is_cpu_file(path, flags) && (fd = open_cpu_file(path, flags)) != -2)
+		return fd;
+	return original(open64)(path, flags, mode);
+}
+
+int openat(int dirfd, const char *path, int flags, ...)
+{
+	mode_t mode;
+	va_list ap;
+	int fd;
+
+	va_start(ap, flags);
+	mode = open_mode(flags, ap);
+	va_end(ap);
+
+	if (is_cpu_file(path, flags) && (fd = open_cpu_file(path, flags)) != -2)
+		return fd;
+	return original(openat)(dirfd, path, flags, mode);
+}
+
+int openat64(int dirfd, const char *path, int flags, ...)
+{
+	mode_t mode;
+	va_list ap;
+	int fd;
+
+	va_start(ap, flags);
+	mode = open_mode(flags, ap);
+	va_end(ap);
+
+	if (is_cpu_file(path, flags) && (fd = open_cpu_file(path, flags)) != -2)
+		return fd;
+	return original(openat64)(dirfd, path, flags, mode);
+}
+
+/*
+ * The checked variants called instead of the functions above by programs
+ * built with _FORTIFY_SOURCE, when the flags are not known at compile time.
+ */
+int __open_2(const char *path, int flags)
+{
+	int fd;
+
+	if (is_cpu_file(path, flags) && (fd = open_cpu_file(path, flags)) != -2)
+		return fd;
+	return original(__open_2)(path, flags);
+}
+
+int __open64_2(const char *path, int flags)
+{
+	int fd;
+
+	if (is_cpu_file(path, flags) && (fd = open_cpu_file(path, flags)) != -2)
+		return fd;
+	return original(__open64_2)(path, flags);
+}
+
+int __openat_2(int dirfd, const char *path, int flags)
+{
+	int fd;
+
+	if (is_cpu_file(path, flags) && (fd = open_cpu_file(path, flags)) != -2)
+		return fd;
+	return original(__openat_2)(dirfd, path, flags);
+}
+
+int __openat64_2(int dirfd, const char *path, int flags)
+{
+	int fd;
+
+	if (is_cpu_file(path, flags) && (fd = open_cpu_file(path, flags)) != -2)
+		return fd;
+	return original(__openat64_2)(dirfd, path, flags);
+}
+
+FILE *fopen(const char *path, const char *mode)
+{
+	int fd, flags = fopen_flags(mode);
+
+	if (is_cpu_file(path, flags) && (fd = open_cpu_file(path, flags)) != -2)
+		return (fd < 0) ? NULL : fdopen(fd, mode);
+	return original(fopen)(path, mode);
+}
+
+FILE *fopen64(const char *path, const char *mode)
+{
+	int fd, flags = fopen_flags(mode);
+
+	if (is_cpu_file(path, flags) && (fd = open_cpu_file(path, flags)) != -2)
+		return (fd < 0) ? NULL : fdopen(fd, mode);
+	return original(fopen64)(path, mode);
+}
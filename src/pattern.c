@@ -0,0 +1,50 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pattern.h>
+
+#include <stdio.h>
+
+
+int expand_pattern(char *dest, size_t len, const char *pattern, pid_t pid)
+{
+	size_t pos = 0;
+	int ret;
+
+	while (*pattern != '\0') {
+		if (pattern[0] == '%' && pattern[1] == 'p') {
+			ret = snprintf(dest + pos, len - pos, "%d", pid);
+			if (ret < 0 || (size_t) ret >= len - pos)
+				return -1;
+			pos += ret;
+			pattern += 2;
+			continue;
+		}
+
+		if (pattern[0] == '%' && pattern[1] == '%')
+			pattern++;
+		if (pos + 1 >= len)
+			return -1;
+		dest[pos++] = *pattern++;
+	}
+
+	if (pos >= len)
+		return -1;
+	dest[pos] = '\0';
+	return 0;
+}
@@ -0,0 +1,461 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <pin.h>
+
+#include <errno.h>
+#include <fnmatch.h>
+#include <getopt.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "procfs.h"
+
+
+#define PROGNAME "pind"
+
+#define TASKS_CHUNK      64
+#define SELECTORS_CHUNK  16
+
+
+struct task
+{
+	pid_t             pid;
+	tid_t             tid;
+	const cpu_set_t  *set;
+	struct slot       slot;
+	size_t            scan;      /* last scan the task has been seen in */
+};
+
+struct selectors
+{
+	const char  **values;
+	size_t        capacity;
+	size_t        length;
+};
+
+
+const char        *progname;
+
+struct selectors   names = { NULL, 0, 0 };
+struct selectors   cgroups = { NULL, 0, 0 };
+
+pid_t             *pids = NULL;
+size_t             pids_capacity = 0;
+size_t             pids_length = 0;
+
+struct task       *tasks = NULL;
+size_t             tasks_capacity = 0;
+size_t             tasks_length = 0;
+
+size_t             scan_every_us = 100000;
+size_t             current_scan = 0;
+char               once = 0;
+char               verbose = 0;
+
+
+static void usage(void)
+{
+	printf("Usage: %s [options] [<pid>...]\n"
+	       "Pin the threads of already running processes according to "
+	       "PIN_RR, PIN_NUMA,\n"
+	       "PIN_POLICY or PIN_RULES, like pin.so does. The processes are "
+	       "given by pid or\n"
+	       "selected by name or cgroup. Every period, the new threads "
+	       "of these processes\n"
+	       "are pinned, and new processes matching a name or a cgroup "
+	       "are watched.\n"
+	       "All the watched threads share the masks of the "
+	       "placement.\n\n", progname);
+	printf("Options:\n"
+	       "  -h, --help             Print this help message and exit\n"
+	       "  -V, --version          Print the version message and exit\n"
+	       "  -p, --period=<ms>      Scan for new threads every <ms> "
+	       "millisecond, which\n"
+	       "                         may be fractional [default = %lu]\n"
+	       "  -n, --name=<pattern>   Watch the processes whose name "
+	       "matches the shell\n"
+	       "                         pattern\n"
+	       "  -g, --cgroup=<path>    Watch the processes in the cgroup "
+	       "v2 <path> or below\n"
+	       "  -o, --once             Pin the current threads and exit\n"
+	       "  -v, --verbose          Print a line <pid>:<tid>:<mask> for "
+	       "each pinned thread,\n"
+	       "                         with the mask index in the "
+	       "placement\n",
+	       scan_every_us / 1000);
+}
+
+static void version(void)
+{
+	printf("%s %s\n%s\n%s\n", PROGNAME, VERSION, AUTHOR, EMAIL);
+}
+
+
+static void usage_error(const char *format, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "%s: ", progname);
+
+	va_start(ap, format);
+	vfprintf(stderr, format, ap);
+	va_end(ap);
+
+	fprintf(stderr, "\nPlease type '%s --help' for more informations\n",
+		progname);
+
+	exit(EXIT_FAILURE);
+}
+
+static void *grow(void *array, size_t *capacity, size_t chunk, size_t size)
+{
+	*capacity += chunk;
+	array = realloc(array, *capacity * size);
+	if (array == NULL) {
+		fprintf(stderr, "%s: memory allocation failed for %lu\n",
+			progname, *capacity * size);
+		exit(EXIT_FAILURE);
+	}
+
+	return array;
+}
+
+static void add_selector(struct selectors *selectors, const char *value)
+{
+	if (selectors->length == selectors->capacity)
+		selectors->values = grow(selectors->values,
+					 &selectors->capacity,
+					 SELECTORS_CHUNK, sizeof (char *));
+	selectors->values[selectors->length++] = value;
+}
+
+
+static void clean_exit(void)
+{
+	fflush(stdout);
+	exit(EXIT_SUCCESS);
+}
+
+static void signal_exit(int signum __attribute__((unused)))
+{
+	clean_exit();
+}
+
+
+static struct task *find_task(pid_t pid, tid_t tid)
+{
+	size_t i;
+
+	for (i=0; i<tasks_length; i++)
+		if (tasks[i].tid == tid && tasks[i].pid == pid)
+			return &tasks[i];
+	return NULL;
+}
+
+static int place_stat_handler(pid_t pid, tid_t tid,
+			      const struct task_stat *stat,
+			      void *data __attribute__((unused)))
+{
+	struct thread_keys keys = { stat->name, NULL, NULL, NULL };
+	struct task *task;
+
+	if (tasks_length == tasks_capacity)
+		tasks = grow(tasks, &tasks_capacity, TASKS_CHUNK,
+			     sizeof (*tasks));
+
+	task = &tasks[tasks_length];
+	task->set = get_next_cpumask(&task->slot, &keys);
+	if (task->set == NULL)
+		return 0;
+
+	/* threads which cannot be pinned are recorded to not retry them */
+	if (sched_setaffinity(tid, cpumask_size(), task->set) != 0) {
+		if (errno == ESRCH) {
+			put_cpumask(&task->slot);
+			return 0;
+		}
+		warning("failed to pin %d:%d", pid, tid);
+		put_cpumask(&task->slot);
+		task->set = NULL;
+	} else {
+		apply_schedule(tid, slot_schedule(&task->slot), NULL);
+		if (verbose)
+			printf("%d:%d:%lu\n", pid, tid, task->slot.index);
+	}
+
+	task->pid = pid;
+	task->tid = tid;
+	task->scan = current_scan;
+	tasks_length++;
+
+	return 0;
+}
+
+/*
+ * Threads are identified by their pid and tid, and are pinned the first scan
+ * they are seen in.
+ */
+static int place_tid_handler(pid_t pid, tid_t tid,
+			     void *data __attribute__((unused)))
+{
+	struct task *task = find_task(pid, tid);
+
+	if (task != NULL)
+		task->scan = current_scan;
+	else
+		for_tid_stat(pid, tid, place_stat_handler, NULL);
+	return 0;
+}
+
+/*
+ * The masks of the threads not seen in the last scan are released.
+ */
+static void release_tasks(void)
+{
+	size_t i = 0;
+
+	while (i < tasks_length) {
+		if (tasks[i].scan == current_scan) {
+			i++;
+			continue;
+		}
+
+		if (tasks[i].set != NULL)
+			put_cpumask(&tasks[i].slot);
+		tasks[i] = tasks[--tasks_length];
+	}
+}
+
+
+static int match_cgroup(pid_t pid)
+{
+	char path[PATH_MAX];
+	size_t i, len;
+
+	if (pid_cgroup(pid, path, sizeof (path)) != 0)
+		return 0;
+
+	for (i=0; i<cgroups.length; i++) {
+		len = strlen(cgroups.values[i]);
+		while (len > 1 && cgroups.values[i][len - 1] == '/')
+			len--;
+		if (strncmp(path, cgroups.values[i], len) == 0
+		    && (path[len] == '\0' || path[len] == '/'
+			|| len == 1))
+			return 1;
+	}
+
+	return 0;
+}
+
+static int select_stat_handler(pid_t pid __attribute__((unused)),
+			       const struct task_stat *stat,
+			       void *data __attribute__((unused)))
+{
+	size_t i;
+
+	for (i=0; i<names.length; i++)
+		if (fnmatch(names.values[i], stat->name, 0) == 0)
+			return 1;
+	return 0;
+}
+
+static int select_pid_handler(pid_t pid, void *data __attribute__((unused)))
+{
+	size_t i;
+
+	if (pid == getpid())
+		return 0;
+
+	for (i=0; i<pids_length; i++)
+		if (pids[i] == pid)
+			return 0;
+
+	if ((names.length > 0
+	     && for_pid_stat(pid, select_stat_handler, NULL) == 1)
+	    || (cgroups.length > 0 && match_cgroup(pid)))
+		foreach_tid(pid, place_tid_handler, NULL);
+
+	return 0;
+}
+
+static void scan(void)
+{
+	size_t i = 0;
+
+	current_scan++;
+
+	while (i < pids_length) {
+		if (foreach_tid(pids[i], place_tid_handler, NULL) == 0) {
+			i++;
+			continue;
+		}
+		pids[i] = pids[--pids_length];
+	}
+
+	if (names.length > 0 || cgroups.length > 0)
+		foreach_pid(select_pid_handler, NULL);
+
+	release_tasks();
+	fflush(stdout);
+}
+
+
+static size_t now_micros(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ul + ts.tv_nsec / 1000ul;
+}
+
+static void sleep_micros(size_t micros)
+{
+	struct timespec req, rem;
+	int ret;
+
+	req.tv_sec = micros / 1000000ul;
+	req.tv_nsec = (micros % 1000000ul) * 1000ul;
+
+	ret = nanosleep(&req, &rem);
+	while (ret != 0)
+		ret = nanosleep(&rem, &rem);
+}
+
+
+static void parse_options(int *_argc, char ***_argv)
+{
+	int c, idx, argc = *_argc;
+	char **argv = *_argv;
+	double period;
+	char *err;
+	static struct option options[] = {
+		{"help",      no_argument,       0, 'h'},
+		{"version",   no_argument,       0, 'V'},
+		{"period",    required_argument, 0, 'p'},
+		{"name",      required_argument, 0, 'n'},
+		{"cgroup",    required_argument, 0, 'g'},
+		{"once",      no_argument,       0, 'o'},
+		{"verbose",   no_argument,       0, 'v'},
+		{ NULL,       0,                 0,  0}
+	};
+
+	opterr = 0;
+
+	while (1) {
+		c = getopt_long(argc, argv, "hVp:n:g:ov", options, &idx);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			usage();
+			exit(EXIT_SUCCESS);
+		case 'V':
+			version();
+			exit(EXIT_SUCCESS);
+		case 'p':
+			period = strtod(optarg, &err);
+			if (*err != '\0')
+				usage_error("invalid period: '%s'", optarg);
+			scan_every_us = period * 1000;
+			if (scan_every_us == 0)
+				usage_error("invalid period: '%s'", optarg);
+			break;
+		case 'n':
+			add_selector(&names, optarg);
+			break;
+		case 'g':
+			add_selector(&cgroups, optarg);
+			break;
+		case 'o':
+			once = 1;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage_error("unknown option '%s'", argv[optind-1]);
+		}
+	}
+
+	*_argc -= optind;
+	*_argv += optind;
+}
+
+static void parse_arguments(int argc, char **argv)
+{
+	char *err;
+	int i;
+
+	if (argc < 1 && names.length == 0 && cgroups.length == 0)
+		usage_error("missing pid, name or cgroup argument");
+
+	for (i=0; i<argc; i++) {
+		if (pids_length == pids_capacity)
+			pids = grow(pids, &pids_capacity, SELECTORS_CHUNK,
+				    sizeof (pid_t));
+		pids[pids_length] = strtol(argv[i], &err, 10);
+		if (*err != '\0' || pids[pids_length] <= 0)
+			usage_error("invalid pid operand: '%s'", argv[i]);
+		pids_length++;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	size_t current, next;
+
+	progname = argv[0];
+	parse_options(&argc, &argv);
+	parse_arguments(argc, argv);
+
+	acquire_arguments();
+	if (placement_cpus(alloca(cpumask_size())) == 0)
+		usage_error("missing placement policy");
+
+	signal(SIGTERM, signal_exit);
+	signal(SIGINT, signal_exit);
+
+	next = now_micros();
+	while (1) {
+		scan();
+
+		if (once)
+			break;
+		if (pids_length == 0 && names.length == 0
+		    && cgroups.length == 0)
+			break;
+
+		current = now_micros();
+		while (next <= current)
+			next += scan_every_us;
+		sleep_micros(next - current);
+	}
+
+	clean_exit();
+	return EXIT_SUCCESS;
+}
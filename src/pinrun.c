@@ -0,0 +1,369 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <pin.h>
+
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+#define PROGNAME "pinrun"
+
+#define TASKS_CHUNK  64
+
+#define TRACE_OPTIONS  (PTRACE_O_TRACECLONE | PTRACE_O_TRACEFORK	\
+			| PTRACE_O_TRACEVFORK)
+
+
+struct task
+{
+	pid_t             tid;
+	const cpu_set_t  *set;
+	struct slot       slot;
+};
+
+
+const char    *progname;
+
+size_t         placement_limit = 0;
+size_t         placed = 0;
+int            detaching = 0;
+
+struct task   *tasks = NULL;
+size_t         tasks_capacity = 0;
+size_t         tasks_length = 0;
+
+
+static void usage(void)
+{
+	printf("Usage: %s [options] [--] <command> [<args>...]\n"
+	       "Run the command and pin each of its threads and child "
+	       "processes as they are\n"
+	       "created, according to PIN_RR, PIN_NUMA or PIN_POLICY, "
+	       "like pin.so does.\n"
+	       "The tasks are followed with ptrace, so this works for "
+	       "programs which create\n"
+	       "their threads without pthread_create() or which are "
+	       "statically linked.\n\n", progname);
+	printf("Options:\n"
+	       "  -h, --help             Print this help message and exit\n"
+	       "  -V, --version          Print the version message and exit\n"
+	       "  -l, --limit=<n>        Stop to follow the command once "
+	       "<n> tasks, the first\n"
+	       "                         one included, have been pinned "
+	       "[default = never]\n");
+}
+
+static void version(void)
+{
+	printf("%s %s\n%s\n%s\n", PROGNAME, VERSION, AUTHOR, EMAIL);
+}
+
+
+static void usage_error(const char *format, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "%s: ", progname);
+
+	va_start(ap, format);
+	vfprintf(stderr, format, ap);
+	va_end(ap);
+
+	fprintf(stderr, "\nPlease type '%s --help' for more informations\n",
+		progname);
+
+	exit(EXIT_FAILURE);
+}
+
+static void fatal(const char *format, ...)
+{
+	int errnum = errno;
+	va_list ap;
+
+	fprintf(stderr, "%s: ", progname);
+
+	va_start(ap, format);
+	vfprintf(stderr, format, ap);
+	va_end(ap);
+
+	fprintf(stderr, ": %s\n", strerror(errnum));
+
+	exit(EXIT_FAILURE);
+}
+
+
+static struct task *find_task(pid_t tid)
+{
+	size_t i;
+
+	for (i=0; i<tasks_length; i++)
+		if (tasks[i].tid == tid)
+			return &tasks[i];
+	return NULL;
+}
+
+/*
+ * Give the next mask of the placement to a new task. The task is stopped
+ * until traced, so it runs on its mask from its very first instruction.
+ */
+static void place_task(pid_t tid)
+{
+	struct task *task;
+
+	if (find_task(tid) != NULL)
+		return;
+
+	if (tasks_length == tasks_capacity) {
+		tasks_capacity += TASKS_CHUNK;
+		tasks = realloc(tasks, sizeof (*tasks) * tasks_capacity);
+		if (tasks == NULL)
+			fatal("memory allocation failed for %lu",
+			      sizeof (*tasks) * tasks_capacity);
+	}
+
+	task = &tasks[tasks_length++];
+	task->tid = tid;
+	task->set = get_next_cpumask(&task->slot, NULL);
+
+	if (task->set != NULL) {
+		if (sched_setaffinity(tid, cpumask_size(), task->set) != 0) {
+			if (errno != ESRCH)
+				warning("failed to pin task %d", tid);
+		} else {
+			apply_schedule(tid, slot_schedule(&task->slot), NULL);
+		}
+	}
+
+	placed++;
+}
+
+static void forget_task(pid_t tid)
+{
+	struct task *task = find_task(tid);
+
+	if (task == NULL)
+		return;
+
+	if (task->set != NULL && !detaching)
+		put_cpumask(&task->slot);
+	*task = tasks[--tasks_length];
+}
+
+/*
+ * Interrupt every traced task so each of them is detached at its next stop.
+ * The tasks keep the masks they have been pinned on.
+ */
+static void start_detach(void)
+{
+	size_t i;
+
+	detaching = 1;
+	for (i=0; i<tasks_length; i++)
+		ptrace(PTRACE_INTERRUPT, tasks[i].tid, 0, 0);
+}
+
+/*
+ * Handle a ptrace stop: pin the tasks reported by a clone or fork event and
+ * deliver the signals the tasks received, then resume the task.
+ * The first stop of a new task can be reported before the event of its
+ * creator, so an unknown task is pinned at this stop instead, and the event
+ * then finds it already placed.
+ */
+static void resume_task(pid_t tid, int status)
+{
+	int event = status >> 16, sig = WSTOPSIG(status);
+	unsigned long msg;
+
+	switch (event) {
+	case PTRACE_EVENT_CLONE:
+	case PTRACE_EVENT_FORK:
+	case PTRACE_EVENT_VFORK:
+		if (ptrace(PTRACE_GETEVENTMSG, tid, 0, &msg) == 0)
+			place_task(msg);
+		sig = 0;
+		break;
+	case PTRACE_EVENT_STOP:
+		place_task(tid);
+		if (sig == SIGSTOP || sig == SIGTSTP || sig == SIGTTIN
+		    || sig == SIGTTOU) {
+			if (detaching) {
+				ptrace(PTRACE_DETACH, tid, 0, 0);
+				forget_task(tid);
+			} else {
+				ptrace(PTRACE_LISTEN, tid, 0, 0);
+			}
+			return;
+		}
+		sig = 0;
+		break;
+	case 0:
+		break;
+	default:
+		sig = 0;
+	}
+
+	if (placement_limit > 0 && placed >= placement_limit && !detaching)
+		start_detach();
+
+	if (detaching) {
+		ptrace(PTRACE_DETACH, tid, 0, sig);
+		forget_task(tid);
+	} else {
+		ptrace(PTRACE_CONT, tid, 0, sig);
+	}
+}
+
+
+static void parse_options(int *_argc, char ***_argv)
+{
+	int c, idx, argc = *_argc;
+	char **argv = *_argv;
+	char *err;
+	static struct option options[] = {
+		{"help",      no_argument,       0, 'h'},
+		{"version",   no_argument,       0, 'V'},
+		{"limit",     required_argument, 0, 'l'},
+		{ NULL,       0,                 0,  0}
+	};
+
+	opterr = 0;
+
+	while (1) {
+		c = getopt_long(argc, argv, "+hVl:", options, &idx);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			usage();
+			exit(EXIT_SUCCESS);
+		case 'V':
+			version();
+			exit(EXIT_SUCCESS);
+		case 'l':
+			placement_limit = strtoul(optarg, &err, 10);
+			if (*err != '\0' || placement_limit == 0)
+				usage_error("invalid limit: '%s'", optarg);
+			break;
+		default:
+			usage_error("unknown option '%s'", argv[optind-1]);
+		}
+	}
+
+	*_argc -= optind;
+	*_argv += optind;
+}
+
+/*
+ * The command waits on a pipe until it is traced and pinned, then executes.
+ */
+static pid_t launch(char **argv)
+{
+	int sync[2];
+	pid_t pid;
+	char c;
+
+	if (pipe(sync) != 0)
+		fatal("cannot create pipe");
+
+	if ((pid = fork()) < 0)
+		fatal("cannot fork");
+
+	if (pid == 0) {
+		close(sync[1]);
+		if (read(sync[0], &c, 1) != 1)
+			_exit(EXIT_FAILURE);
+		close(sync[0]);
+
+		execvp(argv[0], argv);
+		fprintf(stderr, "%s: cannot execute '%s': %s\n", progname,
+			argv[0], strerror(errno));
+		_exit(127);
+	}
+
+	close(sync[0]);
+
+	if (ptrace(PTRACE_SEIZE, pid, 0, TRACE_OPTIONS) != 0) {
+		kill(pid, SIGKILL);
+		fatal("cannot trace '%s'", argv[0]);
+	}
+
+	place_task(pid);
+	if (placement_limit > 0 && placed >= placement_limit)
+		start_detach();
+
+	c = 0;
+	if (write(sync[1], &c, 1) != 1)
+		fatal("cannot start '%s'", argv[0]);
+	close(sync[1]);
+
+	return pid;
+}
+
+int main(int argc, char **argv)
+{
+	int status, child_status = -1;
+	pid_t pid, tid;
+
+	progname = argv[0];
+	parse_options(&argc, &argv);
+
+	if (argc < 1)
+		usage_error("missing command argument");
+
+	acquire_arguments();
+	pid = launch(argv);
+
+	while (tasks_length > 0) {
+		tid = waitpid(-1, &status, __WALL);
+		if (tid < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (WIFEXITED(status) || WIFSIGNALED(status)) {
+			forget_task(tid);
+			if (tid == pid)
+				child_status = status;
+		} else if (WIFSTOPPED(status)) {
+			resume_task(tid, status);
+		}
+	}
+
+	while (child_status == -1 && waitpid(pid, &status, 0) < 0)
+		if (errno != EINTR)
+			fatal("cannot wait for '%s'", argv[0]);
+	if (child_status == -1)
+		child_status = status;
+
+	if (WIFSIGNALED(child_status))
+		return 128 + WTERMSIG(child_status);
+	return WEXITSTATUS(child_status);
+}
@@ -0,0 +1,291 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+
+#define PROGNAME "pintrace"
+
+
+static const char *event_names[TRACE_TYPES] = {
+	"create", "setaffinity", "getaffinity", "rebalance", "repin"
+};
+
+
+const char  *progname;
+
+int          count_only = 0;
+
+
+static void usage(void)
+{
+	printf("Usage: %s [options] <trace>\n"
+	       "Decode a trace written by pin.so with PIN_TRACE. The events "
+	       "of every thread\n"
+	       "are printed in chronological order, one per line, in the "
+	       "form:\n\n"
+	       "  <time>:<tid>:<event>:<target>:<input>:<output>:<ns>:"
+	       "<error>\n\n"
+	       "where <time> is in nanoseconds from the first event, <input> "
+	       "and <output> are\n"
+	       "the masks (in hexadecimal) before and after translation, "
+	       "<ns> is the time\n"
+	       "spent in the call and <error> its error number.\n\n",
+	       progname);
+	printf("Options:\n"
+	       "  -h, --help             Print this help message and exit\n"
+	       "  -V, --version          Print the version message and exit\n"
+	       "  -c, --count            Only print the number of events of "
+	       "each type (in\n"
+	       "                         hexadecimal), one per line: create, "
+	       "setaffinity,\n"
+	       "                         getaffinity, rebalance and repin\n");
+}
+
+static void version(void)
+{
+	printf("%s %s\n%s\n%s\n", PROGNAME, VERSION, AUTHOR, EMAIL);
+}
+
+
+static void usage_error(const char *format, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "%s: ", progname);
+
+	va_start(ap, format);
+	vfprintf(stderr, format, ap);
+	va_end(ap);
+
+	fprintf(stderr, "\nPlease type '%s --help' for more informations\n",
+		progname);
+
+	exit(EXIT_FAILURE);
+}
+
+static void fatal(const char *format, ...)
+{
+	int errnum = errno;
+	va_list ap;
+
+	fprintf(stderr, "%s: ", progname);
+
+	va_start(ap, format);
+	vfprintf(stderr, format, ap);
+	va_end(ap);
+
+	fprintf(stderr, ": %s\n", strerror(errnum));
+
+	exit(EXIT_FAILURE);
+}
+
+
+static void parse_options(int *_argc, char ***_argv)
+{
+	int c, idx, argc = *_argc;
+	char **argv = *_argv;
+	static struct option options[] = {
+		{"help",      no_argument,       0, 'h'},
+		{"version",   no_argument,       0, 'V'},
+		{"count",     no_argument,       0, 'c'},
+		{ NULL,       0,                 0,  0}
+	};
+
+	opterr = 0;
+
+	while (1) {
+		c = getopt_long(argc, argv, "hVc", options, &idx);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			usage();
+			exit(EXIT_SUCCESS);
+		case 'V':
+			version();
+			exit(EXIT_SUCCESS);
+		case 'c':
+			count_only = 1;
+			break;
+		default:
+			usage_error("unknown option '%s'", argv[optind-1]);
+		}
+	}
+
+	*_argc -= optind;
+	*_argv += optind;
+}
+
+static const struct trace_header *map_trace(const char *path)
+{
+	const struct trace_header *header;
+	struct stat st;
+	void *addr;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		fatal("cannot open '%s'", path);
+	if (fstat(fd, &st) != 0)
+		fatal("cannot stat '%s'", path);
+
+	if ((size_t) st.st_size < sizeof (*header)) {
+		errno = EINVAL;
+		fatal("cannot decode '%s'", path);
+	}
+
+	addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED)
+		fatal("cannot map '%s'", path);
+	close(fd);
+
+	header = addr;
+	if (header->magic != TRACE_MAGIC || header->rings > TRACE_RINGS
+	    || header->events != TRACE_EVENTS
+	    || header->mask_words != TRACE_MASK_WORDS
+	    || (size_t) st.st_size < trace_size(header->rings)) {
+		errno = EINVAL;
+		fatal("cannot decode '%s'", path);
+	}
+
+	return header;
+}
+
+/*
+ * Copy the events still in the rings. An event being written while the trace
+ * is read may be torn.
+ */
+static size_t collect_events(struct trace_event **dest,
+			     const struct trace_header *header)
+{
+	size_t i, count = 0, capacity = 0;
+	const struct trace_ring *ring;
+	struct trace_event *events = NULL;
+	uint64_t head, first;
+
+	for (i=0; i<header->rings; i++) {
+		ring = &header->ring[i];
+		head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		first = (head > TRACE_EVENTS) ? head - TRACE_EVENTS : 0;
+
+		if (count + (head - first) > capacity) {
+			capacity = count + (head - first);
+			events = realloc(events, sizeof (*events) * capacity);
+			if (events == NULL)
+				fatal("memory allocation failed for %lu",
+				      sizeof (*events) * capacity);
+		}
+
+		for (; first < head; first++)
+			events[count++] = ring->event[first % TRACE_EVENTS];
+	}
+
+	*dest = events;
+	return count;
+}
+
+static int compare_events(const void *a, const void *b)
+{
+	const struct trace_event *ea = a, *eb = b;
+
+	if (ea->time != eb->time)
+		return (ea->time < eb->time) ? -1 : 1;
+	return ea->tid - eb->tid;
+}
+
+static void print_mask(const uint64_t *mask)
+{
+	int i, display = 0;
+
+	for (i = TRACE_MASK_WORDS - 1; i >= 0; i--) {
+		if (display)
+			printf("%016" PRIx64, mask[i]);
+		else if (mask[i] != 0 || i == 0)
+			printf("%" PRIx64, mask[i]);
+		display |= (mask[i] != 0);
+	}
+}
+
+static void print_event(const struct trace_event *event, uint64_t origin)
+{
+	printf("%" PRIu64 ":%d:", event->time - origin, event->tid);
+
+	if (event->type < TRACE_TYPES)
+		printf("%s:", event_names[event->type]);
+	else
+		printf("%u:", event->type);
+
+	printf("%d:", event->target);
+	print_mask(event->input);
+	printf(":");
+	print_mask(event->output);
+	printf(":%u:%u\n", event->duration, event->error);
+}
+
+int main(int argc, char **argv)
+{
+	size_t counts[TRACE_TYPES] = { 0 };
+	const struct trace_header *header;
+	struct trace_event *events;
+	size_t i, count;
+
+	progname = argv[0];
+	parse_options(&argc, &argv);
+
+	if (argc < 1)
+		usage_error("missing trace argument");
+	if (argc > 1)
+		usage_error("unexpected argument '%s'", argv[1]);
+
+	header = map_trace(argv[0]);
+	count = collect_events(&events, header);
+	qsort(events, count, sizeof (*events), compare_events);
+
+	for (i=0; i<count; i++) {
+		if (count_only && events[i].type < TRACE_TYPES)
+			counts[events[i].type]++;
+		else if (!count_only)
+			print_event(&events[i], events[0].time);
+	}
+
+	if (count_only)
+		for (i=0; i<TRACE_TYPES; i++)
+			printf("%lx\n", counts[i]);
+
+	if (header->dropped > 0)
+		fprintf(stderr, "%s: %" PRIu64 " events dropped\n", progname,
+			header->dropped);
+
+	free(events);
+	return EXIT_SUCCESS;
+}
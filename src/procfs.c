@@ -35,6 +35,10 @@
 #define TASK_PATH_PATTERN       "/proc/%d/task"
 #define TASK_PATH_MAXLEN        (11 + PID_MAXLEN)
 
+#define CGROUP_PATH_PATTERN     "/proc/%d/cgroup"
+#define CGROUP_PATH_MAXLEN      (13 + PID_MAXLEN)
+#define CGROUP_UNIFIED_PREFIX   "0::"
+
 
 static char *slurp(FILE *stream)
 {
@@ -185,6 +189,40 @@ int for_pid_stat(pid_t pid,
 	return ret;
 }
 
+int pid_cgroup(pid_t pid, char *dest, size_t len)
+{
+	char buffer[CGROUP_PATH_MAXLEN + 1];
+	char *rawcontent, *line, *end;
+	int ret = -1;
+
+	snprintf(buffer, sizeof (buffer), CGROUP_PATH_PATTERN, pid);
+	rawcontent = pslurp(buffer);
+	if (rawcontent == NULL)
+		return -1;
+
+	line = rawcontent;
+	while (line != NULL && *line != '\0') {
+		end = strchr(line, '\n');
+		if (end != NULL)
+			*end++ = '\0';
+
+		if (strncmp(line, CGROUP_UNIFIED_PREFIX,
+			    strlen(CGROUP_UNIFIED_PREFIX)) == 0) {
+			line += strlen(CGROUP_UNIFIED_PREFIX);
+			if (strlen(line) < len) {
+				strcpy(dest, line);
+				ret = 0;
+			}
+			break;
+		}
+
+		line = end;
+	}
+
+	free(rawcontent);
+	return ret;
+}
+
 
 int foreach_pid(int (*cb)(pid_t, void *), void *data)
 {
@@ -0,0 +1,264 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <pin.h>
+#include <registry.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define SECOND              1000000000ul
+
+#define REBALANCE_SHARE     4    /* minimum gap, as a share of the period */
+#define REBALANCE_COOLDOWN  4    /* periods a moved thread stays in place */
+
+#define SCHEDSTAT_PATH      "/proc/self/task/%d/schedstat"
+#define SCHEDSTAT_MAXLEN    64
+
+
+struct history
+{
+	pid_t              tid;
+	unsigned long      cpu;        /* cpu time, in nanoseconds */
+	unsigned long      wait;       /* run queue wait time, in nanoseconds */
+	unsigned long      demand;     /* cpu and wait time of the last period */
+	unsigned int       cooldown;   /* periods before to move again */
+	struct placement  *placement;
+	size_t             mask;
+};
+
+struct move
+{
+	size_t  thread;
+	pid_t   tid;
+	size_t  from;
+	size_t  to;
+};
+
+
+static unsigned long   rebalance_period;
+static struct history  history[REGISTRY_RECORDS];
+static size_t          sampled[REGISTRY_RECORDS];
+static size_t          sampled_count;
+
+
+int acquire_rebalance(const char *arg)
+{
+	unsigned long value, unit = 1000000ul;
+	char *err;
+
+	value = strtoul(arg, &err, 10);
+	if (err == arg)
+		return -1;
+
+	if (strcmp(err, "s") == 0)
+		unit = SECOND;
+	else if (strcmp(err, "us") == 0)
+		unit = 1000ul;
+	else if (*err != '\0' && strcmp(err, "ms") != 0)
+		return -1;
+
+	if (value == 0)
+		return -1;
+
+	rebalance_period = value * unit;
+	return 0;
+}
+
+static unsigned long read_wait(pid_t tid)
+{
+	unsigned long run, wait;
+	char path[SCHEDSTAT_MAXLEN];
+	FILE *file;
+	int ret;
+
+	snprintf(path, sizeof (path), SCHEDSTAT_PATH, tid);
+	if ((file = fopen(path, "r")) == NULL)
+		return 0;
+
+	ret = fscanf(file, "%lu %lu", &run, &wait);
+	fclose(file);
+
+	if (ret != 2)
+		return 0;
+	return wait;
+}
+
+static void sample_thread(struct thread_record *record,
+			  void *unused __attribute__((unused)))
+{
+	unsigned long cpu, wait;
+	struct history *entry;
+	struct timespec ts;
+	clockid_t clock;
+	size_t index;
+
+	if (record->set == NULL || thread_index(record, &index) != 0)
+		return;
+	if (pthread_getcpuclockid(record->thread, &clock) != 0)
+		return;
+	if (clock_gettime(clock, &ts) != 0)
+		return;
+
+	cpu = ts.tv_sec * SECOND + ts.tv_nsec;
+	wait = read_wait(record->tid);
+	entry = &history[index];
+
+	if (entry->tid != record->tid) {
+		entry->tid = record->tid;
+		entry->demand = 0;
+		entry->cooldown = 0;
+	} else {
+		entry->demand = (cpu - entry->cpu) + (wait - entry->wait);
+		if (entry->cooldown > 0)
+			entry->cooldown--;
+	}
+
+	entry->cpu = cpu;
+	entry->wait = wait;
+	entry->placement = record->slot.placement;
+	entry->mask = record->slot.index;
+
+	sampled[sampled_count++] = index;
+}
+
+static void apply_move(struct thread_record *record, void *arg)
+{
+	struct move *move = arg;
+	size_t index;
+
+	if (thread_index(record, &index) != 0 || index != move->thread)
+		return;
+	if (record->tid != move->tid || record->set == NULL)
+		return;
+	if (record->slot.index != move->from)
+		return;
+	if (record->slot.placement != history[index].placement)
+		return;
+
+	move_thread(record, move->to);
+	history[index].cooldown = REBALANCE_COOLDOWN;
+}
+
+/*
+ * Find the busiest and the idlest masks of the placement, by the cpu and wait
+ * time of their threads, and move one thread from the first to the second if
+ * the gap is large enough and the move reduces it. Recently moved threads are
+ * left in place so a thread does not bounce between two masks.
+ */
+static int balance_placement(struct placement *placement, struct move *move)
+{
+	size_t i, lead = placement_lead(placement);
+	size_t hot = lead, cold = lead, total = placement_size(placement);
+	unsigned long gap, distance, best = ~0ul;
+	struct history *entry;
+	unsigned long *loads;
+	int found = 0;
+
+	if (total < lead + 2)
+		return 0;
+	if ((loads = calloc(total, sizeof (*loads))) == NULL)
+		return 0;
+
+	for (i=0; i<sampled_count; i++) {
+		entry = &history[sampled[i]];
+		if (entry->placement == placement)
+			loads[entry->mask] += entry->demand;
+	}
+
+	for (i=lead+1; i<total; i++) {
+		if (loads[i] > loads[hot])
+			hot = i;
+		if (loads[i] < loads[cold])
+			cold = i;
+	}
+
+	gap = loads[hot] - loads[cold];
+	if (gap <= rebalance_period / REBALANCE_SHARE)
+		goto out;
+
+	for (i=0; i<sampled_count; i++) {
+		entry = &history[sampled[i]];
+		if (entry->placement != placement || entry->mask != hot)
+			continue;
+		if (entry->cooldown > 0 || entry->demand == 0)
+			continue;
+		if (entry->demand >= gap)
+			continue;
+
+		distance = (gap > 2 * entry->demand) ? gap - 2 * entry->demand
+			: 2 * entry->demand - gap;
+		if (distance >= best)
+			continue;
+
+		best = distance;
+		move->thread = sampled[i];
+		move->tid = entry->tid;
+		move->from = hot;
+		move->to = cold;
+		found = 1;
+	}
+
+ out:
+	free(loads);
+	return found;
+}
+
+static void rebalance(void)
+{
+	struct placement *placement;
+	struct move move;
+	size_t i, j;
+
+	sampled_count = 0;
+	for_each_thread(sample_thread, NULL);
+
+	for (i=0; i<sampled_count; i++) {
+		placement = history[sampled[i]].placement;
+
+		for (j=0; j<i; j++)
+			if (history[sampled[j]].placement == placement)
+				break;
+		if (j < i)
+			continue;
+
+		if (balance_placement(placement, &move))
+			for_each_thread(apply_move, &move);
+	}
+}
+
+void *serve_rebalance(void *arg __attribute__((unused)))
+{
+	struct timespec ts;
+
+	ts.tv_sec = rebalance_period / SECOND;
+	ts.tv_nsec = rebalance_period % SECOND;
+
+	while (1) {
+		nanosleep(&ts, NULL);
+		rebalance();
+	}
+
+	return NULL;
+}
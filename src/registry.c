@@ -0,0 +1,118 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <pin.h>
+#include <pattern.h>
+#include <registry.h>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+static struct registry_header  *registry = NULL;
+static char                     registry_name[NAME_MAX];
+static pid_t                    registry_owner = 0;
+
+
+int open_registry(const char *pattern)
+{
+	size_t size = registry_size(REGISTRY_RECORDS);
+	struct registry_header *header;
+	size_t i;
+	void *addr;
+	int fd;
+
+	if (expand_pattern(registry_name, sizeof (registry_name), pattern,
+			   getpid()))
+		return -1;
+
+	fd = shm_open(registry_name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0)
+		return -1;
+
+	if (ftruncate(fd, size) != 0) {
+		close(fd);
+		shm_unlink(registry_name);
+		return -1;
+	}
+
+	addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		shm_unlink(registry_name);
+		return -1;
+	}
+
+	header = addr;
+	header->records = REGISTRY_RECORDS;
+	header->pid = getpid();
+	for (i=0; i<REGISTRY_RECORDS; i++) {
+		header->record[i].mask = -1;
+		header->record[i].cpu = -1;
+	}
+	__atomic_store_n(&header->magic, REGISTRY_MAGIC, __ATOMIC_RELEASE);
+
+	registry = header;
+	registry_owner = header->pid;
+	return 0;
+}
+
+static void __attribute__((destructor)) close_registry(void)
+{
+	if (registry_owner == 0 || registry_owner != getpid())
+		return;
+
+	shm_unlink(registry_name);
+	registry_owner = 0;
+}
+
+void write_registry(size_t index, pid_t tid, long mask,
+		    unsigned long created)
+{
+	struct registry_record *record;
+	unsigned int sequence;
+
+	if (registry == NULL || index >= REGISTRY_RECORDS)
+		return;
+
+	record = &registry->record[index];
+	sequence = record->sequence;
+
+	__atomic_store_n(&record->sequence, sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	__atomic_store_n(&record->tid, tid, __ATOMIC_RELAXED);
+	__atomic_store_n(&record->mask, mask, __ATOMIC_RELAXED);
+	__atomic_store_n(&record->created, created, __ATOMIC_RELAXED);
+	if (tid == 0)
+		__atomic_store_n(&record->cpu, -1, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&record->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+int *registry_cpu(size_t index)
+{
+	if (registry == NULL || index >= REGISTRY_RECORDS)
+		return NULL;
+	return &registry->record[index].cpu;
+}
@@ -19,11 +19,27 @@
 #define _GNU_SOURCE
 
 #include <pin.h>
+#include <trace.h>
+#include <libpin.h>
 
 #include <dlfcn.h>
+#include <errno.h>
 #include <pthread.h>
 #include <sched.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__has_include)
+#  if __has_include(<sys/rseq.h>)
+#    include <sys/rseq.h>
+#    define HAVE_RSEQ
+#  endif
+#endif
 
 
 static int (*__pthread_create)(pthread_t *thread, const pthread_attr_t *attr,
@@ -35,15 +51,69 @@ static int (*__sched_setaffinity)(pid_t pid, size_t cpusetsize,
 static int (*__sched_getaffinity)(pid_t pid, size_t cpusetsize,
 				  cpu_set_t *mask);
 
+static void (*__pthread_exit)(void *retval) __attribute__((noreturn));
+
+static int (*__pthread_setaffinity_np)(pthread_t thread, size_t cpusetsize,
+				       const cpu_set_t *cpuset);
+
+static int (*__pthread_getaffinity_np)(pthread_t thread, size_t cpusetsize,
+				       cpu_set_t *cpuset);
+
+static int (*__pthread_attr_setaffinity_np)(pthread_attr_t *attr,
+					    size_t cpusetsize,
+					    const cpu_set_t *cpuset);
+
+static int (*__pthread_attr_getaffinity_np)(const pthread_attr_t *attr,
+					    size_t cpusetsize,
+					    cpu_set_t *cpuset);
+
 static int (*__sched_getcpu)(void);
 
+static int (*__getcpu)(unsigned int *cpu, unsigned int *node);
+
+static int (*__pthread_setname_np)(pthread_t thread, const char *name);
+
+
+struct start_context
+{
+	void             *(*start_routine)(void *);
+	void              *arg;
+	const cpu_set_t   *set;
+	struct slot        slot;
+	const char        *symbol;
+	const char        *group;
+	char               comm[THREAD_NAME_LEN];
+	unsigned long      traced;     /* start of the creation, if traced */
+	pid_t              creator;
+	char               identity[IDENTITY_LEN];
+};
+
+
+static cpu_set_t                     *initial_set = NULL;
+
+static __tls struct thread_record *current_record = NULL;
+static __tls struct thread_record  unlisted_record;
+static __tls int                  *current_observed = NULL;
+static __tls const char           *current_group = NULL;
+static __tls char                  current_identity[IDENTITY_LEN];
+static __tls unsigned long         current_children = 0;
+
 
 static inline void load_functions(void)
 {
 	__pthread_create = dlsym(RTLD_NEXT, "pthread_create");
 	__sched_setaffinity = dlsym(RTLD_NEXT, "sched_setaffinity");
 	__sched_getaffinity = dlsym(RTLD_NEXT, "sched_getaffinity");
+	__pthread_exit = dlsym(RTLD_NEXT, "pthread_exit");
+	__pthread_setaffinity_np = dlsym(RTLD_NEXT, "pthread_setaffinity_np");
+	__pthread_getaffinity_np = dlsym(RTLD_NEXT, "pthread_getaffinity_np");
+	__pthread_attr_setaffinity_np = dlsym(RTLD_NEXT,
+					      "pthread_attr_setaffinity_np");
+	__pthread_attr_getaffinity_np = dlsym(RTLD_NEXT,
+					      "pthread_attr_getaffinity_np");
 	__sched_getcpu = dlsym(RTLD_NEXT, "sched_getcpu");
+	__getcpu = dlsym(RTLD_NEXT, "getcpu");
+	__pthread_setname_np = dlsym(RTLD_NEXT, "pthread_setname_np");
 }
 
 
@@ -54,6 +124,11 @@ static inline int original_create(pthread_t *thread,
 	return __pthread_create(thread, attr, start_routine, arg);
 }
 
+static inline void __attribute__((noreturn)) original_exit(void *retval)
+{
+	__pthread_exit(retval);
+}
+
 static inline int original_setaffinity(pid_t pid, size_t cpusetsize,
 				       const cpu_set_t *mask)
 {
@@ -66,58 +141,688 @@ static inline int original_getaffinity(pid_t pid, size_t cpusetsize,
 	return __sched_getaffinity(pid, cpusetsize, mask);
 }
 
+static inline int original_pthread_setaffinity(pthread_t thread,
+					       size_t cpusetsize,
+					       const cpu_set_t *cpuset)
+{
+	return __pthread_setaffinity_np(thread, cpusetsize, cpuset);
+}
+
+static inline int original_pthread_getaffinity(pthread_t thread,
+					       size_t cpusetsize,
+					       cpu_set_t *cpuset)
+{
+	return __pthread_getaffinity_np(thread, cpusetsize, cpuset);
+}
+
+static inline int original_attr_setaffinity(pthread_attr_t *attr,
+					    size_t cpusetsize,
+					    const cpu_set_t *cpuset)
+{
+	return __pthread_attr_setaffinity_np(attr, cpusetsize, cpuset);
+}
+
+static inline int original_attr_getaffinity(const pthread_attr_t *attr,
+					    size_t cpusetsize,
+					    cpu_set_t *cpuset)
+{
+	return __pthread_attr_getaffinity_np(attr, cpusetsize, cpuset);
+}
+
 static inline int original_getcpu(void)
 {
 	return __sched_getcpu();
 }
 
+/*
+ * When the C library registered a rseq area for the thread, the kernel keeps
+ * the current cpu up to date in it and reading it is cheaper than a call to
+ * the original sched_getcpu().
+ */
+static inline int current_cpu(void)
+{
+#ifdef HAVE_RSEQ
+	const struct rseq *area;
+	int cpu;
+
+	if (__rseq_size > 0) {
+		area = (const struct rseq *)
+			((const char *) __builtin_thread_pointer()
+			 + __rseq_offset);
+		cpu = (int) __atomic_load_n(&area->cpu_id, __ATOMIC_RELAXED);
+		if (cpu >= 0)
+			return cpu;
+	}
+#endif
+	return original_getcpu();
+}
+
+static inline int original_setname(pthread_t thread, const char *name)
+{
+	return __pthread_setname_np(thread, name);
+}
+
+static inline int original_getcpu_node(unsigned int *cpu, unsigned int *node)
+{
+	if (__getcpu == NULL)
+		return syscall(SYS_getcpu, cpu, node, NULL);
+	return __getcpu(cpu, node);
+}
+
+
+static const char *routine_symbol(void *(*start_routine)(void *))
+{
+	Dl_info info;
+
+	if (dladdr((void *) start_routine, &info) == 0)
+		return NULL;
+	return info.dli_sname;
+}
+
+/*
+ * Pin the calling thread on the mask given by its creator and register it so
+ * it can be moved later. If the placement changed meanwhile, or if the thread
+ * has been named before to start, the thread takes another mask instead.
+ */
+static void place_thread(const struct start_context *context)
+{
+	struct thread_record *record = register_thread();
+	const cpu_set_t *set;
+	struct timespec now;
+
+	if (record == NULL) {
+		record = &unlisted_record;
+		lock_thread(record);
+	}
+
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	record->thread = pthread_self();
+	record->created = now.tv_sec * 1000000000ul + now.tv_nsec;
+	record->symbol = context->symbol;
+	record->role = NULL;
+	record->group = context->group;
+	record->name[0] = '\0';
+	record->original.policy = -1;
+	record->moved = 0;
+	record->set = context->set;
+	if (context->set != NULL)
+		record->slot = context->slot;
+
+	if (context->comm[0] != '\0') {
+		prctl(PR_GET_NAME, record->name);
+		if (strcmp(record->name, context->comm) == 0)
+			record->name[0] = '\0';
+	}
+
+	set = refresh_cpumask(record);
+	if (set != NULL) {
+		original_setaffinity(0, cpumask_size(), set);
+		apply_schedule(0, slot_schedule(&record->slot),
+			       &record->original);
+	}
+	record->set = set;
+
+	apply_mempolicy(set);
+
+	publish_thread(record);
+	current_observed = observed_cpu(record);
+	if (current_observed != NULL)
+		*current_observed = current_cpu();
+
+	current_record = record;
+	current_group = context->group;
+	strcpy(current_identity, context->identity);
+	current_children = 0;
+	unlock_thread(record);
+
+	trace_event(context->traced, TRACE_CREATE, context->creator, NULL, set,
+		    cpumask_size(), 0);
+}
+
+static void release_cpumask(void *unused __attribute__((unused)))
+{
+	struct thread_record *record = current_record;
+
+	release_trace();
+
+	if (record == NULL)
+		return;
+
+	lock_thread(record);
+	if (record->set != NULL)
+		put_cpumask(&record->slot);
+	record->set = NULL;
+	current_record = NULL;
+	current_observed = NULL;
+
+	if (record == &unlisted_record)
+		unlock_thread(record);
+	else
+		unregister_thread(record);
+}
+
+/*
+ * The thread of a forked child keeps the mask of its parent thread. It is
+ * registered after acquire_arguments() so it runs once the child has its own
+ * shared entry, if any.
+ */
+static void adopt_thread(void)
+{
+	struct thread_record *record = current_record;
+
+	if (record != NULL && record->set != NULL)
+		adopt_cpumask(&record->slot);
+}
+
+/*
+ * The memory policy can only be set by the thread itself, so a thread moved to
+ * another mask applies the policy of its new mask the next time it creates a
+ * thread, renames a thread or sets or gets an affinity. sched_getcpu() and
+ * getcpu() are left out to stay fast.
+ */
+static inline void refresh_mempolicy(void)
+{
+	struct thread_record *record = current_record;
+
+	if (record == NULL
+	    || !__atomic_load_n(&record->moved, __ATOMIC_RELAXED))
+		return;
+
+	lock_thread(record);
+	record->moved = 0;
+	apply_mempolicy(record->set);
+	unlock_thread(record);
+}
+
+static void repin_thread(struct thread_record *record,
+			 void *unused __attribute__((unused)))
+{
+	unsigned long start = trace_start();
+	const cpu_set_t *set = refresh_cpumask(record);
+
+	if (set == record->set)
+		return;
+
+	if (set != NULL) {
+		original_setaffinity(record->tid, cpumask_size(), set);
+		apply_schedule(record->tid, slot_schedule(&record->slot),
+			       &record->original);
+	} else {
+		if (initial_set != NULL)
+			original_setaffinity(record->tid, cpumask_size(),
+					     initial_set);
+		apply_schedule(record->tid, NULL, &record->original);
+	}
+
+	trace_event(start, TRACE_REPIN, record->tid, record->set, set,
+		    cpumask_size(), 0);
+
+	record->set = set;
+	__atomic_store_n(&record->moved, 1, __ATOMIC_RELAXED);
+	publish_thread(record);
+}
+
+void move_thread(struct thread_record *record, size_t index)
+{
+	unsigned long start = trace_start();
+	const cpu_set_t *previous = record->set;
+
+	record->set = move_cpumask(&record->slot, index);
+	original_setaffinity(record->tid, cpumask_size(), record->set);
+	apply_schedule(record->tid, slot_schedule(&record->slot),
+		       &record->original);
+	__atomic_store_n(&record->moved, 1, __ATOMIC_RELAXED);
+	publish_thread(record);
+
+	trace_event(start, TRACE_REBALANCE, record->tid, previous, record->set,
+		    cpumask_size(), 0);
+}
+
+void repin_threads(void)
+{
+	for_each_thread(repin_thread, NULL);
+}
+
+struct rename_request
+{
+	pthread_t    thread;
+	const char  *name;
+};
+
+static void rename_thread(struct thread_record *record, void *arg)
+{
+	struct rename_request *request = arg;
+
+	if (!pthread_equal(record->thread, request->thread))
+		return;
+
+	strncpy(record->name, request->name, THREAD_NAME_LEN - 1);
+	record->name[THREAD_NAME_LEN - 1] = '\0';
+	repin_thread(record, NULL);
+}
+
+/*
+ * Give the thread the mask recorded for its identity by PIN_RECORD in a
+ * previous run, or the next mask, and record it.
+ */
+static const cpu_set_t *choose_cpumask(struct start_context *context,
+				       const struct thread_keys *keys)
+{
+	const cpu_set_t *set;
+	size_t index;
+
+	if (replay_placement(context->identity, context->symbol, &index) == 0)
+		set = get_cpumask_at(&context->slot, keys, index);
+	else
+		set = get_next_cpumask(&context->slot, keys);
+
+	if (set != NULL)
+		record_placement(context->identity, context->symbol,
+				 context->slot.index);
+	return set;
+}
+
+/*
+ * The identity of a new thread is the identity of its creator followed by
+ * its creation ordinal. Threads too deep in the tree have no identity.
+ */
+static void child_identity(char *dest)
+{
+	int len;
+
+	dest[0] = '\0';
+	if (current_identity[0] == '\0')
+		return;
+
+	len = snprintf(dest, IDENTITY_LEN, "%s.%lu", current_identity,
+		       current_children++);
+	if (len < 0 || len >= IDENTITY_LEN)
+		dest[0] = '\0';
+}
+
+static void *start_thread(void *data)
+{
+	struct start_context context = *((struct start_context *) data);
+	void *ret;
+
+	free(data);
+
+	place_thread(&context);
+
+	pthread_cleanup_push(release_cpumask, NULL);
+	ret = context.start_routine(context.arg);
+	pthread_cleanup_pop(1);
+
+	return ret;
+}
 
 int pthread_create(pthread_t *thread, const pthread_attr_t *attr,
 		   void *(*start_routine) (void *), void *arg)
 {
-	const cpu_set_t *set;
+	struct thread_keys keys = { NULL, NULL, NULL, NULL };
+	struct start_context *context;
 	int ret;
 
-	ret = original_create(thread, attr, start_routine, arg);
+	refresh_mempolicy();
+
+	if ((context = malloc(sizeof (*context))) == NULL)
+		return EAGAIN;
+
+	context->start_routine = start_routine;
+	context->arg = arg;
+	context->symbol = NULL;
+	context->group = current_group;
+	context->comm[0] = '\0';
+	context->traced = trace_start();
+	context->creator = (current_record != NULL) ? current_record->tid : 0;
+	child_identity(context->identity);
+
+	if (rules_active()) {
+		context->symbol = routine_symbol(start_routine);
+		prctl(PR_GET_NAME, context->comm);
+	} else if (manifest_active()) {
+		context->symbol = routine_symbol(start_routine);
+	}
+
+	keys.symbol = context->symbol;
+	keys.group = context->group;
+	context->set = choose_cpumask(context, &keys);
 
-	if ((set = get_next_cpumask()) != NULL)
-		pthread_setaffinity_np(*thread, sizeof (*set), set);
+	ret = original_create(thread, attr, start_thread, context);
+	if (ret != 0) {
+		if (context->set != NULL)
+			put_cpumask(&context->slot);
+		free(context);
+	}
 
 	return ret;
 }
 
+void pthread_exit(void *retval)
+{
+	release_cpumask(NULL);
+	original_exit(retval);
+}
+
 int sched_setaffinity(pid_t pid, size_t cpusetsize, const cpu_set_t *mask)
 {
+	unsigned long start = trace_start();
 	cpu_set_t *nmask = alloca(cpusetsize);
+	int ret;
+
+	refresh_mempolicy();
 
 	map_cpuset_forward(nmask, mask, cpusetsize);
-	return original_setaffinity(pid, cpusetsize, nmask);
+	ret = original_setaffinity(pid, cpusetsize, nmask);
+
+	trace_event(start, TRACE_SETAFFINITY, pid, mask, nmask, cpusetsize,
+		    (ret == 0) ? 0 : errno);
+	return ret;
 }
 
 int sched_getaffinity(pid_t pid, size_t cpusetsize, cpu_set_t *mask)
 {
+	unsigned long start = trace_start();
 	cpu_set_t *nmask = alloca(cpusetsize);
 	int ret = original_getaffinity(pid, cpusetsize, nmask);
 
+	refresh_mempolicy();
+
 	if (ret == 0)
 		map_cpuset_reverse(mask, nmask, cpusetsize);
+
+	trace_event(start, TRACE_GETAFFINITY, pid, nmask,
+		    (ret == 0) ? mask : NULL, cpusetsize,
+		    (ret == 0) ? 0 : errno);
 	return ret;
 }
 
+int pthread_setaffinity_np(pthread_t thread, size_t cpusetsize,
+			   const cpu_set_t *cpuset)
+{
+	unsigned long start = trace_start();
+	cpu_set_t *nmask = alloca(cpusetsize);
+	int ret;
+
+	refresh_mempolicy();
+
+	map_cpuset_forward(nmask, cpuset, cpusetsize);
+	ret = original_pthread_setaffinity(thread, cpusetsize, nmask);
+
+	trace_event(start, TRACE_SETAFFINITY, 0, cpuset, nmask, cpusetsize,
+		    ret);
+	return ret;
+}
+
+int pthread_getaffinity_np(pthread_t thread, size_t cpusetsize,
+			   cpu_set_t *cpuset)
+{
+	unsigned long start = trace_start();
+	cpu_set_t *nmask = alloca(cpusetsize);
+	int ret = original_pthread_getaffinity(thread, cpusetsize, nmask);
+
+	refresh_mempolicy();
+
+	if (ret == 0)
+		map_cpuset_reverse(cpuset, nmask, cpusetsize);
+
+	trace_event(start, TRACE_GETAFFINITY, 0, nmask,
+		    (ret == 0) ? cpuset : NULL, cpusetsize, ret);
+	return ret;
+}
+
+int pthread_attr_setaffinity_np(pthread_attr_t *attr, size_t cpusetsize,
+				const cpu_set_t *cpuset)
+{
+	unsigned long start = trace_start();
+	cpu_set_t *nmask = alloca(cpusetsize);
+	int ret;
+
+	map_cpuset_forward(nmask, cpuset, cpusetsize);
+	ret = original_attr_setaffinity(attr, cpusetsize, nmask);
+
+	trace_event(start, TRACE_SETAFFINITY, 0, cpuset, nmask, cpusetsize,
+		    ret);
+	return ret;
+}
+
+int pthread_attr_getaffinity_np(const pthread_attr_t *attr,
+				size_t cpusetsize, cpu_set_t *cpuset)
+{
+	unsigned long start = trace_start();
+	cpu_set_t *nmask = alloca(cpusetsize);
+	int ret = original_attr_getaffinity(attr, cpusetsize, nmask);
+
+	if (ret == 0)
+		map_cpuset_reverse(cpuset, nmask, cpusetsize);
+
+	trace_event(start, TRACE_GETAFFINITY, 0, nmask,
+		    (ret == 0) ? cpuset : NULL, cpusetsize, ret);
+	return ret;
+}
+
+/*
+ * Renaming a thread may make it match another placement rule.
+ */
+int pthread_setname_np(pthread_t thread, const char *name)
+{
+	struct rename_request request = { thread, name };
+	int ret = original_setname(thread, name);
+
+	if (ret == 0)
+		for_each_thread(rename_thread, &request);
+
+	refresh_mempolicy();
+	return ret;
+}
+
+/*
+ * When the registry is enabled, the cpu returned to the thread is also stored
+ * as its last observed cpu.
+ */
+static inline void observe_cpu(int cpu)
+{
+	int *observed = current_observed;
+
+	if (observed != NULL)
+		__atomic_store_n(observed, cpu, __ATOMIC_RELAXED);
+}
+
 int sched_getcpu(void)
 {
-	int cpu = original_getcpu();
+	int cpu = current_cpu();
+
+	observe_cpu(cpu);
 	return map_cpu_reverse(cpu);
 }
 
+int getcpu(unsigned int *cpu, unsigned int *node)
+{
+	int ret = original_getcpu_node(cpu, node);
+
+	if (ret == 0 && cpu != NULL) {
+		observe_cpu(*cpu);
+		*cpu = map_cpu_reverse(*cpu);
+	}
+	return ret;
+}
+
+
+/*
+ * The libpin interface, which takes precedence over libpin.so when pin.so is
+ * preloaded. A new role places the calling thread again, like a new name.
+ */
+int pin_hint(int role)
+{
+	struct thread_record *record = current_record;
+	const char *tag;
+
+	if (role_tag(role, &tag) != 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (record == NULL) {
+		errno = ESRCH;
+		return -1;
+	}
+
+	lock_thread(record);
+	record->role = tag;
+	repin_thread(record, NULL);
+	unlock_thread(record);
+
+	refresh_mempolicy();
+	return 0;
+}
+
+int pin_group_begin(const char *name)
+{
+	const char *tag;
+
+	if (name == NULL || *name == '\0') {
+		errno = EINVAL;
+		return -1;
+	}
+	if ((tag = group_tag(name)) == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	current_group = tag;
+	return 0;
+}
+
+int pin_group_end(void)
+{
+	if (current_group == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	current_group = NULL;
+	return 0;
+}
+
+int pin_current_mask(size_t size, cpu_set_t *mask)
+{
+	struct thread_record *record = current_record;
+	size_t len = cpumask_size();
+	cpu_set_t *set, *mapped;
+
+	if (len < size)
+		len = size;
+	set = alloca(len);
+	mapped = alloca(len);
+	memset(set, 0, len);
+
+	if (record == NULL) {
+		errno = ESRCH;
+		return -1;
+	}
+
+	lock_thread(record);
+	if (record->set != NULL)
+		memcpy(set, record->set, cpumask_size());
+	unlock_thread(record);
+
+	if (CPU_COUNT_S(len, set) == 0) {
+		errno = ESRCH;
+		return -1;
+	}
+
+	map_cpuset_reverse(mapped, set, len);
+	memcpy(mask, mapped, size);
+	return 0;
+}
+
+
+/*
+ * The service threads of pin.so are neither pinned nor registered: they run
+ * on the cpus the process was started on.
+ */
+static int start_service(void *(*routine)(void *), void *arg)
+{
+	pthread_attr_t attr;
+	pthread_t thread;
+	int err;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if (initial_set != NULL)
+		original_attr_setaffinity(&attr, cpumask_size(), initial_set);
+
+	err = original_create(&thread, &attr, routine, arg);
+	pthread_attr_destroy(&attr);
+
+	return err;
+}
+
+static void start_control(const char *pattern)
+{
+	int fd;
+
+	if ((fd = open_control(pattern)) < 0) {
+		warning("failed to open '%s' = '%s'", "PIN_CONTROL", pattern);
+		return;
+	}
+
+	if (start_service(serve_control, (void *) (long) fd) != 0) {
+		warning("failed to serve '%s' = '%s'", "PIN_CONTROL", pattern);
+		close(fd);
+	}
+}
 
 static void __attribute__((constructor)) init(void)
 {
-	const cpu_set_t *set;
+	struct start_context context;
+	char *arg, *rebalance;
 	
 	acquire_arguments();
 	load_functions();
+	pthread_atfork(NULL, NULL, adopt_thread);
+
+	rebalance = getenv("PIN_REBALANCE");
+	if (rebalance != NULL && acquire_rebalance(rebalance) != 0)
+		error("failed to parse '%s' = '%s'", "PIN_REBALANCE",
+		      rebalance);
+
+	initial_set = malloc(cpumask_size());
+	if (initial_set != NULL &&
+	    original_getaffinity(0, cpumask_size(), initial_set) != 0) {
+		free(initial_set);
+		initial_set = NULL;
+	}
+
+	arg = getenv("PIN_REGISTRY");
+	if (arg != NULL && open_registry(arg) != 0)
+		warning("failed to open '%s' = '%s'", "PIN_REGISTRY", arg);
+
+	arg = getenv("PIN_TRACE");
+	if (arg != NULL && open_trace(arg) != 0)
+		warning("failed to open '%s' = '%s'", "PIN_TRACE", arg);
+
+	arg = getenv("PIN_REPLAY");
+	if (arg != NULL && open_replay(arg) != 0)
+		warning("failed to open '%s' = '%s'", "PIN_REPLAY", arg);
+
+	arg = getenv("PIN_RECORD");
+	if (arg != NULL && open_record(arg) != 0)
+		warning("failed to open '%s' = '%s'", "PIN_RECORD", arg);
+
+	memset(&context, 0, sizeof (context));
+	context.traced = trace_start();
+	strcpy(context.identity, "0");
+	context.set = choose_cpumask(&context, NULL);
+	place_thread(&context);
+
+	acquire_nprocs(getenv("PIN_NPROCS"));
+
+	arg = getenv("PIN_CONTROL");
+	if (arg != NULL)
+		start_control(arg);
 
-	if ((set = get_next_cpumask()) != NULL)
-		pthread_setaffinity_np(pthread_self(), sizeof (*set), set);
+	if (rebalance != NULL && start_service(serve_rebalance, NULL) != 0)
+		warning("failed to start '%s' = '%s'", "PIN_REBALANCE",
+			rebalance);
 }
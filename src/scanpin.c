@@ -17,15 +17,21 @@
  */
 
 #include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
+#include <limits.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "pattern.h"
 #include "procfs.h"
+#include "registry.h"
 
 
 #define PROGNAME "scanpin"
@@ -33,6 +39,8 @@
 #define SLURP_CHUNK 256
 #define PIDS_CHUNK  16
 
+#define DEFAULT_REGISTRY  "/pin.%p"
+
 
 const char *progname;
 
@@ -45,7 +53,10 @@ pid_t  *pids_to_scan = NULL;
 size_t  pids_capacity = 0;
 size_t  pids_length = 0;
 
-size_t  scan_every_ms = 100;
+const char               *registry_pattern = NULL;
+struct registry_header  **registries = NULL;
+
+size_t  scan_every_us = 100000;
 size_t  current_time;
 
 
@@ -68,15 +79,26 @@ static void usage(void)
 	       "  -h, --help             Print this help message and exit\n"
 	       "  -V, --version          Print the version message and exit\n"
 	       "  -p, --period=<ms>      Collect information every <ms> "
-	       "millisecond\n"
-	       "                         [default = %lu]\n"
+	       "millisecond, which\n"
+	       "                         may be fractional [default = %lu]\n"
 	       "  -c, --children[=<n>]   Collect information for children "
 	       "too. Only scan for\n"
 	       "                         children once every <n> period "
 	       "[default = %lu]\n"
 	       "  -n, --name             Print the name of the tracked processes with lines:\n"
-	       "                         <time>:<pid>=<name>\n",
-	       scan_every_ms, default_children);
+	       "                         <time>:<pid>=<name>\n"
+	       "  -r, --registry[=<name>]\n"
+	       "                         Read the cores from the registry "
+	       "exported by pin.so\n"
+	       "                         with PIN_REGISTRY instead of procfs, "
+	       "where %%p stands\n"
+	       "                         for the pid [default = %s]. The "
+	       "core is then the\n"
+	       "                         last one pin.so observed the thread "
+	       "on, when pinned\n"
+	       "                         or calling sched_getcpu(), and may "
+	       "be stale\n",
+	       scan_every_us / 1000, default_children, DEFAULT_REGISTRY);
 }
 
 static void version(void)
@@ -127,6 +149,77 @@ static void signal_exit(int signum __attribute__((unused)))
 }
 
 
+static void print_time(size_t micros)
+{
+	if (scan_every_us % 1000 == 0)
+		printf("%lu", micros / 1000);
+	else
+		printf("%lu.%03lu", micros / 1000, micros % 1000);
+}
+
+
+static struct registry_header *map_registry(pid_t pid)
+{
+	struct registry_header *header;
+	char name[NAME_MAX];
+	size_t size;
+	void *addr;
+	int fd;
+
+	if (expand_pattern(name, sizeof (name), registry_pattern, pid) != 0)
+		return NULL;
+	if ((fd = shm_open(name, O_RDONLY, 0)) < 0)
+		return NULL;
+
+	size = registry_size(REGISTRY_RECORDS);
+	addr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED)
+		return NULL;
+
+	header = addr;
+	if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE)
+	    != REGISTRY_MAGIC || header->pid != pid
+	    || header->records != REGISTRY_RECORDS) {
+		munmap(addr, size);
+		return NULL;
+	}
+
+	return header;
+}
+
+static void unmap_registry(struct registry_header *header)
+{
+	if (header != NULL)
+		munmap(header, registry_size(REGISTRY_RECORDS));
+}
+
+static int print_registry(pid_t pid, const struct registry_header *header,
+			  size_t time)
+{
+	struct registry_record record;
+	size_t i;
+
+	if (kill(pid, 0) != 0 && errno == ESRCH)
+		return -1;
+
+	for (i=0; i<header->records; i++) {
+		if (__atomic_load_n(&header->record[i].tid, __ATOMIC_RELAXED)
+		    == 0)
+			continue;
+
+		read_registry_record(&record, &header->record[i]);
+		if (record.tid == 0 || record.cpu < 0)
+			continue;
+
+		print_time(time);
+		printf(":%d:%d:%d\n", pid, record.tid, record.cpu);
+	}
+
+	return 0;
+}
+
+
 static int track_pid(pid_t pid)
 {
 	if (pids_length == pids_capacity) {
@@ -136,15 +229,28 @@ static int track_pid(pid_t pid)
 		if (pids_to_scan == NULL)
 			error("memory allocation failed for %lu",
 			      sizeof (pid_t) * pids_capacity);
+		registries = realloc(registries, sizeof (*registries)
+				     * pids_capacity);
+		if (registries == NULL)
+			error("memory allocation failed for %lu",
+			      sizeof (*registries) * pids_capacity);
 	}
 
+	registries[pids_length] = NULL;
+	if (registry_pattern != NULL)
+		registries[pids_length] = map_registry(pid);
+
 	pids_to_scan[pids_length++] = pid;
 	return 0;
 }
 
 static void untrack_pid(size_t index)
 {
-	pids_to_scan[index] = pids_to_scan[--pids_length];
+	unmap_registry(registries[index]);
+
+	pids_length--;
+	pids_to_scan[index] = pids_to_scan[pids_length];
+	registries[index] = registries[pids_length];
 }
 
 
@@ -153,7 +259,8 @@ static int print_core_stat_handler(pid_t pid, tid_t tid,
 				   const struct task_stat *stat,
 				   void *data)
 {
-	printf("%lu:%d:%d:%u\n", *((size_t *) data), pid, tid, stat->core);
+	print_time(*((size_t *) data));
+	printf(":%d:%d:%u\n", pid, tid, stat->core);
 	return 0;
 }
 
@@ -161,7 +268,8 @@ static int print_name_stat_handler(pid_t pid,
 				   const struct task_stat *stat,
 				   void *data)
 {
-	printf("%lu:%d=%s\n", *((size_t *) data), pid, stat->name);
+	print_time(*((size_t *) data));
+	printf(":%d=%s\n", pid, stat->name);
 	return 0;
 }
 
@@ -189,8 +297,10 @@ static int track_stat_handler(pid_t pid,
 			child = 1;
 	}
 
-	if (child && print_name)
-		printf("%lu:%d=%s\n", *((size_t *) data), pid, stat->name);
+	if (child && print_name) {
+		print_time(*((size_t *) data));
+		printf(":%d=%s\n", pid, stat->name);
+	}
 	if (child)
 		track_pid(pid);
 
@@ -204,20 +314,20 @@ static int track_pid_handler(pid_t pid, void *data)
 }
 
 
-static size_t now_millis(void)
+static size_t now_micros(void)
 {
 	struct timespec ts;
 	clock_gettime(CLOCK_REALTIME, &ts);
-	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000ul;
+	return ts.tv_sec * 1000000ul + ts.tv_nsec / 1000ul;
 }
 
-static void sleep_millis(size_t millis)
+static void sleep_micros(size_t micros)
 {
 	struct timespec req, rem;
 	int ret;
 
-	req.tv_sec = millis / 1000;
-	req.tv_nsec = (millis % 1000) * 1000000ul;
+	req.tv_sec = micros / 1000000ul;
+	req.tv_nsec = (micros % 1000000ul) * 1000ul;
 
 	ret = nanosleep(&req, &rem);
 	while (ret != 0)
@@ -229,6 +339,7 @@ static void parse_options(int *_argc, char ***_argv)
 {
 	int c, idx, argc = *_argc;
 	char **argv = *_argv;
+	double period;
 	char *err;
 	static struct option options[] = {
 		{"help",      no_argument,       0, 'h'},
@@ -236,13 +347,14 @@ static void parse_options(int *_argc, char ***_argv)
 		{"period",    required_argument, 0, 'p'},
 		{"children",  optional_argument, 0, 'c'},
 		{"name",      no_argument,       0, 'n'},
+		{"registry",  optional_argument, 0, 'r'},
 		{ NULL,       0,                 0,  0}
 	};
 
 	opterr = 0;
 
 	while (1) {
-		c = getopt_long(argc, argv, "hVp:cn", options, &idx);
+		c = getopt_long(argc, argv, "hVp:cnr::", options, &idx);
 		if (c == -1)
 			break;
 
@@ -254,10 +366,11 @@ static void parse_options(int *_argc, char ***_argv)
 			version();
 			exit(EXIT_SUCCESS);
 		case 'p':
-			scan_every_ms = strtol(optarg, &err, 10);
+			period = strtod(optarg, &err);
 			if (*err != '\0')
 				error("invalid period: '%s'", optarg);
-			if (scan_every_ms == 0)
+			scan_every_us = period * 1000;
+			if (scan_every_us == 0)
 				error("invalid period: '%s'", optarg);
 			break;
 		case 'c':
@@ -274,6 +387,9 @@ static void parse_options(int *_argc, char ***_argv)
 		case 'n':
 			print_name = 1;
 			break;
+		case 'r':
+			registry_pattern = optarg ? optarg : DEFAULT_REGISTRY;
+			break;
 		default:
 			error("unknown option '%s'", argv[optind-1]);
 		}
@@ -315,20 +431,26 @@ int main(int argc, char **argv)
 	signal(SIGTERM, signal_exit);
 	signal(SIGINT, signal_exit);
 
-	start = now_millis();
+	start = now_micros();
 	next = start;
 
 	step = 0;
 	while (1) {
-		current = now_millis();
+		current = now_micros();
 		current_time = current - start;
 
 		if (step == 0)
 			foreach_pid(track_pid_handler, &current_time);
 
 		for (i=0; i < pids_length; i++) {
-			ret = foreach_tid(pids_to_scan[i], print_tid_handler,
-					  &current_time);
+			if (registries[i] != NULL)
+				ret = print_registry(pids_to_scan[i],
+						     registries[i],
+						     current_time);
+			else
+				ret = foreach_tid(pids_to_scan[i],
+						  print_tid_handler,
+						  &current_time);
 			if (ret != 0)
 				untrack_pid(i);
 
@@ -340,8 +462,8 @@ int main(int argc, char **argv)
 			step = 0;
 
 		while (next <= current)
-			next += scan_every_ms;
-		sleep_millis(next - current);
+			next += scan_every_us;
+		sleep_micros(next - current);
 	}
 
 	/* dead code */
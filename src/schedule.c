@@ -0,0 +1,181 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <pin.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+/*
+ * The first version of the kernel struct sched_attr, which the C library
+ * does not always declare.
+ */
+struct kernel_sched_attr
+{
+	uint32_t  size;
+	uint32_t  sched_policy;
+	uint64_t  sched_flags;
+	int32_t   sched_nice;
+	uint32_t  sched_priority;
+	uint64_t  sched_runtime;
+	uint64_t  sched_deadline;
+	uint64_t  sched_period;
+};
+
+
+static const struct
+{
+	const char  *name;
+	int          policy;
+	int          min;       /* range of the value, nice or priority */
+	int          max;
+	int          needed;    /* if the value must be given */
+} schedule_policies[] = {
+	{ "fifo",  SCHED_FIFO,    1, 99, 1 },
+	{ "rr",    SCHED_RR,      1, 99, 1 },
+	{ "nice",  SCHED_OTHER, -20, 19, 1 },
+	{ "batch", SCHED_BATCH, -20, 19, 0 },
+	{ "idle",  SCHED_IDLE,    0,  0, 0 },
+	{ NULL, 0, 0, 0, 0 }
+};
+
+static int  schedule_warned = 0;
+
+
+/*
+ * Parse scheduling attributes like "fifo:50", "nice:10" or "idle".
+ */
+int parse_schedule(struct schedule *dest, const char *str, size_t len)
+{
+	char *buffer = alloca(len + 1), *value, *end;
+	size_t i;
+	long val = 0;
+
+	memcpy(buffer, str, len);
+	buffer[len] = '\0';
+
+	if ((value = strchr(buffer, ':')) != NULL)
+		*value++ = '\0';
+
+	for (i=0; schedule_policies[i].name != NULL; i++)
+		if (strcmp(buffer, schedule_policies[i].name) == 0)
+			break;
+
+	if (schedule_policies[i].name == NULL)
+		return -1;
+	if (value == NULL && schedule_policies[i].needed)
+		return -1;
+
+	if (value != NULL) {
+		val = strtol(value, &end, 10);
+		if (*value == '\0' || *end != '\0')
+			return -1;
+	}
+
+	if (val < schedule_policies[i].min || val > schedule_policies[i].max)
+		return -1;
+
+	dest->policy = schedule_policies[i].policy;
+	dest->value = val;
+	return 0;
+}
+
+static int set_schedule(pid_t tid, const struct schedule *schedule)
+{
+	struct kernel_sched_attr attr;
+	int ret;
+
+	memset(&attr, 0, sizeof (attr));
+	attr.size = sizeof (attr);
+	attr.sched_policy = schedule->policy;
+	if (schedule->policy == SCHED_FIFO || schedule->policy == SCHED_RR)
+		attr.sched_priority = schedule->value;
+	else
+		attr.sched_nice = schedule->value;
+
+	ret = syscall(SYS_sched_setattr, tid, &attr, 0);
+
+	/* kernels older than 3.14 only have the nice value for SCHED_OTHER */
+	if (ret != 0 && errno == ENOSYS && schedule->policy == SCHED_OTHER)
+		ret = setpriority(PRIO_PROCESS, tid, schedule->value);
+
+	return ret;
+}
+
+static int get_schedule(pid_t tid, struct schedule *dest)
+{
+	struct kernel_sched_attr attr;
+
+	if (syscall(SYS_sched_getattr, tid, &attr, sizeof (attr), 0) == 0) {
+		dest->policy = attr.sched_policy;
+		if (attr.sched_policy == SCHED_FIFO
+		    || attr.sched_policy == SCHED_RR)
+			dest->value = attr.sched_priority;
+		else
+			dest->value = attr.sched_nice;
+		return 0;
+	}
+
+	if (errno != ENOSYS)
+		return -1;
+
+	errno = 0;
+	dest->policy = SCHED_OTHER;
+	dest->value = getpriority(PRIO_PROCESS, tid);
+	return errno == 0 ? 0 : -1;
+}
+
+/*
+ * Set the scheduling attributes of a thread. A failure, usually for missing
+ * privileges, leaves the thread pinned with its current attributes and is
+ * only reported once.
+ * If original is not NULL, the attributes the thread had before it is first
+ * given some are saved there, and they are restored when the thread is then
+ * moved to a mask without attributes. An original policy of -1 means there is
+ * nothing to restore.
+ */
+void apply_schedule(pid_t tid, const struct schedule *schedule,
+		    struct schedule *original)
+{
+	int ret;
+
+	if (schedule == NULL || schedule->policy < 0) {
+		if (original == NULL || original->policy < 0)
+			return;
+		ret = set_schedule(tid, original);
+		original->policy = -1;
+	} else {
+		if (original != NULL && original->policy < 0
+		    && get_schedule(tid, original) != 0)
+			original->policy = -1;
+		ret = set_schedule(tid, schedule);
+	}
+
+	if (ret != 0 && errno != ESRCH
+	    && !__atomic_exchange_n(&schedule_warned, 1, __ATOMIC_RELAXED))
+		warning("failed to set scheduling attributes: %s",
+			strerror(errno));
+}
@@ -0,0 +1,219 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <pin.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+#define SHARED_EMPTY        0
+#define SHARED_INITIALIZING 1
+#define SHARED_READY        2
+
+#define SHARED_PROCESSES    128
+#define SHARED_WAIT_ROUNDS  1000000
+
+
+struct shared_header
+{
+	unsigned int   state;
+	size_t         total;
+	unsigned long  signature;
+	size_t         cursor __attribute__((aligned(CACHELINE_SIZE)));
+	size_t         occupancy[] __attribute__((aligned(CACHELINE_SIZE)));
+};
+
+
+static struct shared_header  *shared = NULL;
+static size_t                 shared_size;
+static size_t                *own_entry = NULL;
+static size_t               **own_occupancy = NULL;
+
+
+/*
+ * The segment is made of a header, the global occupancy of each mask and one
+ * entry per attached process. A process entry starts with the process pid
+ * followed by the occupancy of each mask by the threads of this process only,
+ * so the threads of a dead process can be subtracted from the global
+ * occupancy.
+ */
+static inline size_t entry_length(size_t total)
+{
+	return 1 + total;
+}
+
+static inline size_t *process_entry(size_t index)
+{
+	return shared->occupancy + shared->total
+		+ index * entry_length(shared->total);
+}
+
+static int wait_ready(void)
+{
+	size_t round;
+
+	for (round=0; round < SHARED_WAIT_ROUNDS; round++) {
+		if (__sync_fetch_and_add(&shared->state, 0) == SHARED_READY)
+			return 0;
+		sched_yield();
+	}
+
+	return -1;
+}
+
+static void release_entry(size_t *entry)
+{
+	size_t i, count;
+
+	for (i=0; i < shared->total; i++) {
+		count = __sync_fetch_and_and(&entry[1 + i], 0);
+		__sync_fetch_and_sub(&shared->occupancy[i], count);
+	}
+
+	__sync_synchronize();
+	entry[0] = 0;
+}
+
+static void reclaim_dead_processes(void)
+{
+	size_t i, *entry;
+	pid_t pid;
+
+	for (i=0; i < SHARED_PROCESSES; i++) {
+		entry = process_entry(i);
+		pid = entry[0];
+
+		if (pid <= 0)
+			continue;
+		if (kill(pid, 0) == 0 || errno != ESRCH)
+			continue;
+
+		if (!__sync_bool_compare_and_swap(&entry[0], pid,
+						  (size_t) -pid))
+			continue;
+		release_entry(entry);
+	}
+}
+
+static size_t *claim_entry(void)
+{
+	size_t i, *entry;
+	pid_t pid = getpid();
+
+	for (i=0; i < SHARED_PROCESSES; i++) {
+		entry = process_entry(i);
+		if (__sync_bool_compare_and_swap(&entry[0], 0, pid))
+			return entry;
+	}
+
+	return NULL;
+}
+
+/*
+ * A forked child inherits the entry of its parent, which it must neither
+ * count its threads in nor release. It claims an entry of its own, or keeps
+ * counting its threads in the global occupancy only if none is left.
+ */
+static void fork_shared(void)
+{
+	if (own_entry == NULL)
+		return;
+
+	own_entry = claim_entry();
+	*own_occupancy = own_entry != NULL ? own_entry + 1 : NULL;
+}
+
+int attach_shared(const char *name, size_t total, unsigned long signature,
+		  size_t **cursor, size_t **occupancy, size_t **own)
+{
+	size_t size = sizeof (struct shared_header) + sizeof (size_t)
+		* (total + SHARED_PROCESSES * entry_length(total));
+	struct stat st;
+	void *addr;
+	int fd;
+
+	if ((fd = shm_open(name, O_RDWR | O_CREAT, 0600)) < 0)
+		return -1;
+
+	if (fstat(fd, &st) != 0)
+		goto err_close;
+	if (st.st_size == 0 && ftruncate(fd, size) != 0)
+		goto err_close;
+	if (st.st_size != 0 && (size_t) st.st_size != size)
+		goto err_close;
+
+	addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED)
+		return -1;
+
+	shared = addr;
+	shared_size = size;
+
+	if (__sync_bool_compare_and_swap(&shared->state, SHARED_EMPTY,
+					 SHARED_INITIALIZING)) {
+		shared->total = total;
+		shared->signature = signature;
+		__sync_synchronize();
+		shared->state = SHARED_READY;
+	} else if (wait_ready() != 0) {
+		goto err_unmap;
+	}
+
+	if (shared->total != total || shared->signature != signature)
+		goto err_unmap;
+
+	reclaim_dead_processes();
+
+	if ((own_entry = claim_entry()) == NULL)
+		goto err_unmap;
+
+	*cursor = &shared->cursor;
+	*occupancy = shared->occupancy;
+	*own = own_entry + 1;
+	own_occupancy = own;
+
+	pthread_atfork(NULL, NULL, fork_shared);
+	return 0;
+ err_close:
+	close(fd);
+	return -1;
+ err_unmap:
+	munmap(shared, shared_size);
+	shared = NULL;
+	return -1;
+}
+
+void detach_shared(void)
+{
+	if (own_entry == NULL)
+		return;
+
+	release_entry(own_entry);
+	own_entry = NULL;
+}
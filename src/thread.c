@@ -0,0 +1,147 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <pin.h>
+#include <registry.h>
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+#define THREADS_MAX  REGISTRY_RECORDS
+
+
+/*
+ * Every pinned thread owns a record in this table so the control thread can
+ * move it when the placement changes. A record is free when its tid is 0 and
+ * its lock is only taken by the owner thread or by the control thread.
+ */
+static struct thread_record  threads[THREADS_MAX];
+static size_t                threads_hint = 0;
+
+
+void lock_thread(struct thread_record *record)
+{
+	while (__sync_lock_test_and_set(&record->lock, 1))
+		while (__atomic_load_n(&record->lock, __ATOMIC_RELAXED))
+			sched_yield();
+}
+
+void unlock_thread(struct thread_record *record)
+{
+	__sync_lock_release(&record->lock);
+}
+
+/*
+ * Claim a free record for the calling thread and return it locked, or NULL if
+ * the table is full.
+ */
+struct thread_record *register_thread(void)
+{
+	size_t i, start = __atomic_load_n(&threads_hint, __ATOMIC_RELAXED);
+	struct thread_record *record;
+
+	for (i=0; i<THREADS_MAX; i++) {
+		record = &threads[(start + i) % THREADS_MAX];
+		if (__atomic_load_n(&record->tid, __ATOMIC_RELAXED) != 0)
+			continue;
+		if (__sync_lock_test_and_set(&record->lock, 1))
+			continue;
+		if (record->tid != 0) {
+			unlock_thread(record);
+			continue;
+		}
+
+		record->tid = syscall(SYS_gettid);
+		record->set = NULL;
+		record->slot.placement = NULL;
+		__atomic_store_n(&threads_hint, (start + i + 1) % THREADS_MAX,
+				 __ATOMIC_RELAXED);
+		return record;
+	}
+
+	return NULL;
+}
+
+int thread_index(const struct thread_record *record, size_t *index)
+{
+	if (record < threads || record >= threads + THREADS_MAX)
+		return -1;
+
+	*index = record - threads;
+	return 0;
+}
+
+/*
+ * Free a record. The caller must hold the record lock, which is released.
+ */
+void unregister_thread(struct thread_record *record)
+{
+	size_t index;
+
+	if (thread_index(record, &index) == 0)
+		write_registry(index, 0, -1, 0);
+
+	__atomic_store_n(&record->tid, 0, __ATOMIC_RELAXED);
+	unlock_thread(record);
+}
+
+/*
+ * Copy the placement of a record in the registry, if any. The caller must
+ * hold the record lock.
+ */
+void publish_thread(const struct thread_record *record)
+{
+	size_t index;
+
+	if (thread_index(record, &index) != 0)
+		return;
+
+	write_registry(index, record->tid,
+		       record->set ? (long) record->slot.index : -1,
+		       record->created);
+}
+
+int *observed_cpu(const struct thread_record *record)
+{
+	size_t index;
+
+	if (thread_index(record, &index) != 0)
+		return NULL;
+	return registry_cpu(index);
+}
+
+void for_each_thread(void (*func)(struct thread_record *, void *), void *arg)
+{
+	struct thread_record *record;
+	size_t i;
+
+	for (i=0; i<THREADS_MAX; i++) {
+		record = &threads[i];
+		if (__atomic_load_n(&record->tid, __ATOMIC_RELAXED) == 0)
+			continue;
+
+		lock_thread(record);
+		if (record->tid != 0)
+			func(record, arg);
+		unlock_thread(record);
+	}
+}
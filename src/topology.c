@@ -0,0 +1,518 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <pin.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+#define SYSFS_ROOT_DEFAULT   "/sys"
+#define SYSFS_PATH_MAXLEN    4096
+#define SYSFS_VALUE_MAXLEN   4096
+
+#define NODE_PATH            "/devices/system/node"
+#define NODE_CPULIST_PATTERN NODE_PATH "/node%d/cpulist"
+
+#define CPU_PATH             "/devices/system/cpu"
+#define CPU_ONLINE_PATH      CPU_PATH "/online"
+#define CPU_TOPOLOGY_PATTERN CPU_PATH "/cpu%d/topology/%s"
+#define CPU_CACHE_PATTERN    CPU_PATH "/cpu%d/cache/index%d/%s"
+#define CPU_CACHE_MAXINDEX   16
+#define CPU_CLASS_PATTERN    CPU_PATH "/%s"
+#define CPU_CAPACITY_PATTERN CPU_PATH "/cpu%d/cpu_capacity"
+
+#define HYBRID_CORE_PATH     "/devices/cpu_core/cpus"
+#define HYBRID_ATOM_PATH     "/devices/cpu_atom/cpus"
+
+#define CGROUP_SELF_PATH     "/proc/self/cgroup"
+#define CGROUP_CPUS_PATTERN  "/fs/cgroup%s/cpuset.cpus.effective"
+
+
+static const char *sysfs_root(void)
+{
+	const char *root = getenv("PIN_SYSFS");
+
+	if (root == NULL)
+		return SYSFS_ROOT_DEFAULT;
+	return root;
+}
+
+static int vsysfs_path(char *dest, size_t len, const char *format,
+		       va_list ap)
+{
+	size_t done;
+	int ret;
+
+	ret = snprintf(dest, len, "%s", sysfs_root());
+	if (ret < 0 || (size_t) ret >= len)
+		return -1;
+	done = ret;
+
+	ret = vsnprintf(dest + done, len - done, format, ap);
+	if (ret < 0 || (size_t) ret >= len - done)
+		return -1;
+
+	return 0;
+}
+
+int sysfs_path(char *dest, size_t len, const char *format, ...)
+{
+	va_list ap;
+	int ret;
+
+	va_start(ap, format);
+	ret = vsysfs_path(dest, len, format, ap);
+	va_end(ap);
+
+	return ret;
+}
+
+/*
+ * The cpu files of sysfs may be faked by pin.so itself (see PIN_NPROCS), so
+ * they are opened with the raw system call rather than through open().
+ */
+static ssize_t vsysfs_read(char *dest, size_t len, const char *format,
+			   va_list ap)
+{
+	char path[SYSFS_PATH_MAXLEN];
+	ssize_t done = 0, ret = 0;
+	int fd;
+
+	if (vsysfs_path(path, sizeof (path), format, ap) != 0)
+		return -1;
+	if ((fd = syscall(SYS_openat, AT_FDCWD, path, O_RDONLY)) < 0)
+		return -1;
+
+	while ((size_t) done < len - 1) {
+		ret = read(fd, dest + done, len - 1 - done);
+		if (ret <= 0)
+			break;
+		done += ret;
+	}
+
+	close(fd);
+
+	if (ret < 0)
+		return -1;
+
+	while (done > 0 && (dest[done-1] == '\n' || dest[done-1] == ' '))
+		done--;
+	dest[done] = '\0';
+
+	return done;
+}
+
+ssize_t sysfs_read(char *dest, size_t len, const char *format, ...)
+{
+	va_list ap;
+	ssize_t ret;
+
+	va_start(ap, format);
+	ret = vsysfs_read(dest, len, format, ap);
+	va_end(ap);
+
+	return ret;
+}
+
+int sysfs_cpulist(cpu_set_t *dest, const char *format, ...)
+{
+	char buffer[SYSFS_VALUE_MAXLEN];
+	va_list ap;
+	ssize_t ret;
+
+	va_start(ap, format);
+	ret = vsysfs_read(buffer, sizeof (buffer), format, ap);
+	va_end(ap);
+
+	if (ret < 0)
+		return -1;
+
+	if (ret == 0) {
+		CPU_ZERO_S(cpumask_size(), dest);
+		return 0;
+	}
+
+	return parse_cpumask(dest, buffer, ret);
+}
+
+
+/*
+ * The affinity of the process when it starts. The tests simulate another
+ * affinity with the cpu list in PIN_TEST_AFFINITY.
+ */
+int read_affinity(cpu_set_t *dest)
+{
+	const char *arg = getenv("PIN_TEST_AFFINITY");
+
+	if (arg != NULL)
+		return parse_cpumask(dest, arg, strlen(arg));
+
+	CPU_ZERO_S(cpumask_size(), dest);
+	if (syscall(SYS_sched_getaffinity, 0, cpumask_size(), dest) < 0)
+		return -1;
+	return 0;
+}
+
+/*
+ * Read the effective cpus of the cgroup v2 cpuset of the process, if any.
+ */
+static int read_cgroup_cpus(cpu_set_t *dest)
+{
+	char *line = NULL, *end;
+	size_t len = 0;
+	int ret = -1;
+	FILE *file;
+
+	if ((file = fopen(CGROUP_SELF_PATH, "r")) == NULL)
+		return -1;
+
+	while (getline(&line, &len, file) >= 0) {
+		if (strncmp(line, "0::", 3) != 0)
+			continue;
+
+		if ((end = strchr(line, '\n')) != NULL)
+			*end = '\0';
+		if (strcmp(line + 3, "/") == 0)
+			line[3] = '\0';
+
+		ret = sysfs_cpulist(dest, CGROUP_CPUS_PATTERN, line + 3);
+		break;
+	}
+
+	free(line);
+	fclose(file);
+	return ret;
+}
+
+int read_allowed_cpus(cpu_set_t *dest)
+{
+	size_t size = cpumask_size();
+	cpu_set_t *cgroup = alloca(size);
+
+	if (read_affinity(dest) != 0)
+		return -1;
+
+	if (read_cgroup_cpus(cgroup) == 0 && CPU_COUNT_S(size, cgroup) > 0)
+		CPU_AND_S(size, dest, dest, cgroup);
+
+	return 0;
+}
+
+/*
+ * Read the cpus reserved by the kernel command line, from one of the sysfs
+ * files "isolated" or "nohz_full". A missing file means no reserved cpu.
+ */
+int read_cpu_class(cpu_set_t *dest, const char *name)
+{
+	if (strcmp(name, "isolated") != 0 && strcmp(name, "nohz_full") != 0)
+		return -1;
+
+	if (sysfs_cpulist(dest, CPU_CLASS_PATTERN, name) != 0)
+		CPU_ZERO_S(cpumask_size(), dest);
+	return 0;
+}
+
+
+static int compare_nodes(const void *a, const void *b)
+{
+	const struct numa_node *na = a, *nb = b;
+
+	return na->id - nb->id;
+}
+
+ssize_t read_numa_nodes(struct numa_node **dest)
+{
+	char path[SYSFS_PATH_MAXLEN];
+	struct numa_node *nodes = NULL, *nnodes;
+	size_t count = 0, capacity = 0;
+	struct dirent *entry;
+	DIR *dir;
+	char *err;
+	int id;
+
+	if (sysfs_path(path, sizeof (path), NODE_PATH) != 0)
+		return -1;
+	if ((dir = opendir(path)) == NULL)
+		return -1;
+
+	while ((entry = readdir(dir)) != NULL) {
+		if (strncmp(entry->d_name, "node", 4) != 0)
+			continue;
+		if (entry->d_name[4] == '\0')
+			continue;
+
+		id = strtol(entry->d_name + 4, &err, 10);
+		if (*err != '\0')
+			continue;
+
+		if (count == capacity) {
+			capacity = capacity ? capacity << 1 : 8;
+			nnodes = realloc(nodes, sizeof (*nodes) * capacity);
+			if (nnodes == NULL)
+				goto err;
+			nodes = nnodes;
+		}
+
+		nodes[count].id = id;
+		nodes[count].cpus = calloc(1, cpumask_size());
+		if (nodes[count].cpus == NULL)
+			goto err;
+		count++;
+
+		if (sysfs_cpulist(nodes[count-1].cpus, NODE_CPULIST_PATTERN,
+				  id) != 0)
+			goto err;
+	}
+
+	closedir(dir);
+
+	qsort(nodes, count, sizeof (*nodes), compare_nodes);
+
+	*dest = nodes;
+	return count;
+ err:
+	closedir(dir);
+	free_numa_nodes(nodes, count);
+	return -1;
+}
+
+void free_numa_nodes(struct numa_node *nodes, size_t count)
+{
+	size_t i;
+
+	for (i=0; i<count; i++)
+		free(nodes[i].cpus);
+	free(nodes);
+}
+
+
+static int sysfs_int(int *dest, int fallback, const char *format, ...)
+{
+	char buffer[SYSFS_VALUE_MAXLEN];
+	va_list ap;
+	ssize_t ret;
+	char *err;
+
+	va_start(ap, format);
+	ret = vsysfs_read(buffer, sizeof (buffer), format, ap);
+	va_end(ap);
+
+	if (ret <= 0) {
+		*dest = fallback;
+		return 0;
+	}
+
+	*dest = strtol(buffer, &err, 10);
+	if (*err != '\0')
+		return -1;
+	return 0;
+}
+
+/*
+ * Read the performance and efficiency cores of a hybrid processor, as listed
+ * by the cpu_core and cpu_atom pmus. Otherwise, the cores with the highest
+ * cpu_capacity are the performance ones, and without capacity all the cores
+ * are.
+ */
+int read_core_classes(cpu_set_t *perf, cpu_set_t *eff)
+{
+	size_t size = cpumask_size();
+	cpu_set_t *online = alloca(size);
+	int cpu, capacity, best = -1;
+
+	if (sysfs_cpulist(perf, HYBRID_CORE_PATH) == 0) {
+		if (sysfs_cpulist(eff, HYBRID_ATOM_PATH) != 0)
+			CPU_ZERO_S(size, eff);
+		return 0;
+	}
+
+	if (sysfs_cpulist(online, CPU_ONLINE_PATH) != 0)
+		return -1;
+
+	for (cpu=0; (size_t) cpu < (size << 3); cpu++) {
+		if (!CPU_ISSET_S(cpu, size, online))
+			continue;
+		if (sysfs_int(&capacity, -1, CPU_CAPACITY_PATTERN, cpu) != 0)
+			return -1;
+		if (capacity > best)
+			best = capacity;
+	}
+
+	CPU_ZERO_S(size, perf);
+	CPU_ZERO_S(size, eff);
+
+	for (cpu=0; (size_t) cpu < (size << 3); cpu++) {
+		if (!CPU_ISSET_S(cpu, size, online))
+			continue;
+		sysfs_int(&capacity, -1, CPU_CAPACITY_PATTERN, cpu);
+		if (capacity == best)
+			CPU_SET_S(cpu, size, perf);
+		else
+			CPU_SET_S(cpu, size, eff);
+	}
+
+	return 0;
+}
+
+static int first_cpu(const cpu_set_t *set)
+{
+	size_t size = cpumask_size();
+	int cpu;
+
+	for (cpu=0; (size_t) cpu < (size << 3); cpu++)
+		if (CPU_ISSET_S(cpu, size, set))
+			return cpu;
+	return -1;
+}
+
+static int read_cpu_llc(struct cpu_topology *dest)
+{
+	char type[SYSFS_VALUE_MAXLEN];
+	int index, level, best = -1;
+	size_t size = cpumask_size();
+	cpu_set_t *shared = alloca(size);
+
+	for (index=0; index < CPU_CACHE_MAXINDEX; index++) {
+		if (sysfs_int(&level, -1, CPU_CACHE_PATTERN, dest->cpu, index,
+			      "level") != 0)
+			return -1;
+		if (level < 0)
+			break;
+		if (level <= best)
+			continue;
+
+		if (sysfs_read(type, sizeof (type), CPU_CACHE_PATTERN,
+			       dest->cpu, index, "type") < 0)
+			continue;
+		if (strcmp(type, "Instruction") == 0)
+			continue;
+
+		if (sysfs_cpulist(shared, CPU_CACHE_PATTERN, dest->cpu,
+				  index, "shared_cpu_list") != 0)
+			continue;
+		if (!CPU_ISSET_S(dest->cpu, size, shared))
+			continue;
+
+		best = level;
+		dest->llc = first_cpu(shared);
+	}
+
+	return 0;
+}
+
+static int read_cpu(struct cpu_topology *dest, int cpu)
+{
+	size_t size = cpumask_size();
+	int i;
+
+	dest->cpu = cpu;
+
+	if (sysfs_int(&dest->package, 0, CPU_TOPOLOGY_PATTERN, cpu,
+		      "physical_package_id") != 0)
+		return -1;
+	if (sysfs_int(&dest->die, 0, CPU_TOPOLOGY_PATTERN, cpu,
+		      "die_id") != 0)
+		return -1;
+
+	if ((dest->siblings = calloc(1, size)) == NULL)
+		return -1;
+	if (sysfs_cpulist(dest->siblings, CPU_TOPOLOGY_PATTERN, cpu,
+			  "core_cpus_list") != 0
+	    && sysfs_cpulist(dest->siblings, CPU_TOPOLOGY_PATTERN, cpu,
+			     "thread_siblings_list") != 0)
+		CPU_ZERO_S(size, dest->siblings);
+	CPU_SET_S(cpu, size, dest->siblings);
+
+	dest->core = first_cpu(dest->siblings);
+	dest->smt = 0;
+	for (i=0; i<cpu; i++)
+		if (CPU_ISSET_S(i, size, dest->siblings))
+			dest->smt++;
+
+	dest->llc = -1;
+	if (read_cpu_llc(dest) != 0)
+		return -1;
+
+	return 0;
+}
+
+ssize_t read_cpu_topology(struct cpu_topology **dest)
+{
+	size_t i, j, count = 0, size = cpumask_size();
+	cpu_set_t *online = alloca(size);
+	struct cpu_topology *cpus;
+	int cpu;
+
+	if (sysfs_cpulist(online, CPU_ONLINE_PATH) != 0)
+		return -1;
+	cpus = calloc(CPU_COUNT_S(size, online) + 1, sizeof (*cpus));
+	if (cpus == NULL)
+		return -1;
+
+	for (cpu=0; (size_t) cpu < (size << 3); cpu++) {
+		if (!CPU_ISSET_S(cpu, size, online))
+			continue;
+		if (read_cpu(cpus + count, cpu) != 0) {
+			free_cpu_topology(cpus, count + 1);
+			return -1;
+		}
+		count++;
+	}
+
+	for (i=0; i<count; i++)
+		if (cpus[i].llc < 0)
+			cpus[i].llc = cpus[i].core;
+
+	for (i=0; i<count; i++) {
+		cpus[i].core_rank = 0;
+		cpus[i].llc_rank = 0;
+
+		for (j=0; j<count; j++) {
+			if (cpus[j].llc == cpus[i].llc
+			    && cpus[j].core == cpus[j].cpu
+			    && cpus[j].core < cpus[i].core)
+				cpus[i].core_rank++;
+			if (cpus[j].package == cpus[i].package
+			    && cpus[j].llc == cpus[j].cpu
+			    && cpus[j].llc < cpus[i].llc)
+				cpus[i].llc_rank++;
+		}
+	}
+
+	*dest = cpus;
+	return count;
+}
+
+void free_cpu_topology(struct cpu_topology *cpus, size_t count)
+{
+	size_t i;
+
+	for (i=0; i<count; i++)
+		free(cpus[i].siblings);
+	free(cpus);
+}
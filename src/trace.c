@@ -0,0 +1,180 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <pin.h>
+#include <pattern.h>
+#include <trace.h>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+
+static struct trace_header  *trace = NULL;
+
+static __tls struct trace_ring  *current_ring = NULL;
+static __tls int                 ring_missing = 0;
+
+
+/*
+ * A forked child would write in the rings of its parent, so it does not
+ * trace at all.
+ */
+static void stop_trace(void)
+{
+	trace = NULL;
+	current_ring = NULL;
+}
+
+int open_trace(const char *pattern)
+{
+	size_t size = trace_size(TRACE_RINGS);
+	struct trace_header *header;
+	char path[PATH_MAX];
+	void *addr;
+	int fd;
+
+	if (expand_pattern(path, sizeof (path), pattern, getpid()))
+		return -1;
+
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return -1;
+
+	if (ftruncate(fd, size) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED)
+		return -1;
+
+	header = addr;
+	header->rings = TRACE_RINGS;
+	header->events = TRACE_EVENTS;
+	header->mask_words = TRACE_MASK_WORDS;
+	header->pid = getpid();
+	__atomic_store_n(&header->magic, TRACE_MAGIC, __ATOMIC_RELEASE);
+
+	pthread_atfork(NULL, NULL, stop_trace);
+	__atomic_store_n(&trace, header, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static struct trace_ring *claim_ring(struct trace_header *header)
+{
+	pid_t tid = syscall(SYS_gettid);
+	int32_t expected;
+	size_t i;
+
+	for (i=0; i<TRACE_RINGS; i++) {
+		expected = 0;
+		if (__atomic_compare_exchange_n(&header->ring[i].tid,
+						&expected, tid, 0,
+						__ATOMIC_ACQUIRE,
+						__ATOMIC_RELAXED))
+			return &header->ring[i];
+	}
+
+	return NULL;
+}
+
+void release_trace(void)
+{
+	struct trace_ring *ring = current_ring;
+
+	current_ring = NULL;
+	ring_missing = 0;
+
+	if (ring != NULL)
+		__atomic_store_n(&ring->tid, 0, __ATOMIC_RELEASE);
+}
+
+static inline unsigned long trace_clock(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ul + now.tv_nsec;
+}
+
+unsigned long trace_start(void)
+{
+	if (__atomic_load_n(&trace, __ATOMIC_RELAXED) == NULL)
+		return 0;
+	return trace_clock();
+}
+
+static void copy_mask(uint64_t *dest, const cpu_set_t *src, size_t len)
+{
+	memset(dest, 0, TRACE_MASK_WORDS * sizeof (uint64_t));
+	if (src == NULL)
+		return;
+	if (len > TRACE_MASK_WORDS * sizeof (uint64_t))
+		len = TRACE_MASK_WORDS * sizeof (uint64_t);
+	memcpy(dest, src, len);
+}
+
+/*
+ * Record an event started at the time returned by trace_start(), which is 0
+ * when tracing is disabled.
+ */
+void trace_event(unsigned long start, int type, pid_t target,
+		 const cpu_set_t *input, const cpu_set_t *output, size_t len,
+		 int error)
+{
+	struct trace_header *header = __atomic_load_n(&trace,
+						      __ATOMIC_ACQUIRE);
+	struct trace_ring *ring = current_ring;
+	struct trace_event *event;
+	uint64_t head;
+
+	if (start == 0 || header == NULL)
+		return;
+
+	if (ring == NULL && !ring_missing) {
+		ring = current_ring = claim_ring(header);
+		ring_missing = (ring == NULL);
+	}
+	if (ring == NULL) {
+		__atomic_add_fetch(&header->dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	head = ring->head;
+	event = &ring->event[head % TRACE_EVENTS];
+
+	event->time = start;
+	event->duration = trace_clock() - start;
+	event->type = type;
+	event->error = error;
+	event->tid = ring->tid;
+	event->target = target;
+	copy_mask(event->input, input, len);
+	copy_mask(event->output, output, len);
+
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+static const char  *method;
+static cpu_set_t    requested;
+static cpu_set_t    physical;
+static cpu_set_t    readback;
+static cpu_set_t    reported;
+static size_t       requested_size = sizeof (cpu_set_t);
+
+static pthread_attr_t  thread_attr;
+
+
+static void usage(void)
+{
+	printf("Usage: affinity <method> <mask> [<size>]\n"
+	       "Pin a thread on the specified mask (in hexadecimal) with "
+	       "one of the following\n"
+	       "methods, passing a mask of <size> bytes if specified, then "
+	       "print three masks\n"
+	       "(in hexadecimal):\n"
+	       "the core the thread runs on according to the raw getcpu "
+	       "system call,\n"
+	       "the affinity read back with the same method,\n"
+	       "the core the thread runs on according to getcpu().\n\n");
+	printf("Methods:\n"
+	       "  sched     sched_setaffinity() / sched_getaffinity()\n"
+	       "  pthread   pthread_setaffinity_np() / "
+	       "pthread_getaffinity_np()\n"
+	       "  attr      pthread_attr_setaffinity_np() / "
+	       "pthread_attr_getaffinity_np()\n");
+}
+
+
+static void record(void)
+{
+	unsigned int cpu;
+
+	syscall(SYS_getcpu, &cpu, NULL, NULL);
+	CPU_SET(cpu, &physical);
+
+	getcpu(&cpu, NULL);
+	CPU_SET(cpu, &reported);
+}
+
+static void *run_attr(void *arg __attribute__((unused)))
+{
+	record();
+	pthread_attr_getaffinity_np(&thread_attr, sizeof (readback),
+				    &readback);
+
+	return NULL;
+}
+
+static int run(void)
+{
+	pthread_t tid;
+
+	if (!strcmp(method, "sched")) {
+		sched_setaffinity(0, requested_size, &requested);
+		record();
+		sched_getaffinity(0, sizeof (readback), &readback);
+	} else if (!strcmp(method, "pthread")) {
+		pthread_setaffinity_np(pthread_self(), requested_size,
+				       &requested);
+		record();
+		pthread_getaffinity_np(pthread_self(), sizeof (readback),
+				       &readback);
+	} else if (!strcmp(method, "attr")) {
+		pthread_attr_init(&thread_attr);
+		pthread_attr_setaffinity_np(&thread_attr, requested_size,
+					    &requested);
+		pthread_create(&tid, &thread_attr, run_attr, NULL);
+		pthread_join(tid, NULL);
+		pthread_attr_destroy(&thread_attr);
+	} else {
+		return -1;
+	}
+
+	return 0;
+}
+
+static void parse_arguments(int argc, const char **argv)
+{
+	const char *name = argv[0];
+	size_t j, hexa;
+	char *err;
+
+	if (argc > 1 && (!strcmp(argv[1], "--help")
+			 || !strcmp(argv[1], "-h"))) {
+		usage();
+		exit(EXIT_SUCCESS);
+	}
+
+	if (argc != 3 && argc != 4)
+		goto err;
+
+	if (argc == 4) {
+		requested_size = strtoul(argv[3], &err, 10);
+		if (*err != '\0' || requested_size == 0
+		    || requested_size > sizeof (requested))
+			goto err;
+	}
+
+	method = argv[1];
+
+	hexa = strtol(argv[2], &err, 16);
+	if (*err != '\0')
+		goto err;
+
+	CPU_ZERO(&requested);
+	for (j=0; j<(sizeof (hexa) << 3); j++)
+		if (hexa & (1ul << j))
+			CPU_SET(j, &requested);
+
+	return;
+ err:
+	fprintf(stderr, "%s: invalid arguments\n"
+		"Please type '%s --help' for more informations\n",
+		name, name);
+	exit(EXIT_FAILURE);
+}
+
+static void display_mask(const cpu_set_t *mask)
+{
+	unsigned long hexa = 0;
+	size_t j;
+
+	for (j=0; j<(sizeof (hexa) << 3); j++)
+		if (CPU_ISSET(j, mask))
+			hexa |= (1ul << j);
+
+	printf("%lx\n", hexa);
+}
+
+int main(int argc, const char **argv)
+{
+	parse_arguments(argc, argv);
+
+	CPU_ZERO(&physical);
+	CPU_ZERO(&readback);
+	CPU_ZERO(&reported);
+
+	if (run() != 0) {
+		fprintf(stderr, "%s: unknown method '%s'\n"
+			"Please type '%s --help' for more informations\n",
+			argv[0], method, argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	display_mask(&physical);
+	display_mask(&readback);
+	display_mask(&reported);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <linux/mempolicy.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+
+#define SECOND       (1000000000ul)
+#define ROUNDS       8
+
+
+static size_t megabytes = 256;
+
+
+static void usage(void)
+{
+	printf("Usage: bandwidth [<megabytes> [<node>]]\n"
+	       "Allocate and touch a buffer of <megabytes> [default = %lu], "
+	       "then read it %d\n"
+	       "times and print the read bandwidth in megabytes per second.\n"
+	       "If <node> is specified, the buffer is bound to this NUMA "
+	       "node, otherwise\n"
+	       "it follows the memory policy of the thread.\n", megabytes,
+	       ROUNDS);
+}
+
+
+static unsigned long gettime()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * SECOND + ts.tv_nsec;
+}
+
+static int bind_node(void *addr, size_t len, long node)
+{
+	unsigned long nodemask[16];
+	size_t bits = sizeof (nodemask) << 3;
+
+	if (node < 0 || (size_t) node >= bits)
+		return -1;
+
+	memset(nodemask, 0, sizeof (nodemask));
+	nodemask[node / (sizeof (long) << 3)] |=
+		1ul << (node % (sizeof (long) << 3));
+
+	return syscall(SYS_mbind, addr, len, MPOL_BIND, nodemask, bits + 1,
+		       0);
+}
+
+int main(int argc, const char **argv)
+{
+	unsigned long start, elapsed, sum = 0;
+	size_t i, round, len, words;
+	unsigned long *buffer;
+	long node = -1;
+	char *err;
+
+	if (argc > 1 && (!strcmp(argv[1], "--help")
+			 || !strcmp(argv[1], "-h"))) {
+		usage();
+		return EXIT_SUCCESS;
+	}
+
+	if (argc > 1) {
+		megabytes = strtol(argv[1], &err, 10);
+		if (*err != '\0' || megabytes == 0)
+			goto err;
+	}
+
+	if (argc > 2) {
+		node = strtol(argv[2], &err, 10);
+		if (*err != '\0')
+			goto err;
+	}
+
+	len = megabytes << 20;
+	words = len / sizeof (*buffer);
+	buffer = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffer == MAP_FAILED) {
+		perror(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (node >= 0 && bind_node(buffer, len, node) != 0) {
+		perror(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	for (i=0; i<words; i++)
+		buffer[i] = i;
+
+	start = gettime();
+	for (round=0; round<ROUNDS; round++)
+		for (i=0; i<words; i++)
+			sum += buffer[i];
+	elapsed = gettime() - start;
+
+	__asm__ volatile ("" : : "r" (sum));
+
+	printf("%.0f\n", (double) (megabytes * ROUNDS) * SECOND / elapsed);
+
+	return EXIT_SUCCESS;
+ err:
+	fprintf(stderr, "%s: invalid arguments\n"
+		"Please type '%s --help' for more informations\n",
+		argv[0], argv[0]);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,91 @@
+#!/bin/sh
+# Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+# This file is part of pin.
+#
+# Pin is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# Pin is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with pin.  If not, see <http://www.gnu.org/licenses/>.
+
+
+LIB="$1"
+if [ "x$2" != "x" ] ; then
+    BIN="$2"
+else
+    BIN=./
+fi
+
+
+all_cores()
+{
+    last=$(( `getconf _NPROCESSORS_ONLN` - 1 ))
+
+    for cpu in `seq 0 $last` ; do
+	printf "%d " $cpu
+    done
+}
+
+
+bench_create()
+{
+    creators="$1"
+
+    native=`"$BIN/create" $creators`
+    pinned=`PIN_RR="$RR" LD_PRELOAD="$LIB" "$BIN/create" $creators`
+
+    printf "%-10s %-10s %-10s %-10s %-10s\n" $creators $native $pinned
+}
+
+
+RR=`all_cores`
+MAP=`seq 0 1023 | awk '{ printf "%d=%d ", $1, ($1 * 37) % 1024 }'`
+
+echo "pthread_create() latency in nanoseconds (PIN_RR = '$RR')"
+printf "%-10s %-10s %-10s %-10s %-10s\n" creators native-p50 native-p99 \
+       pin-p50 pin-p99
+for creators in 1 8 64 256 ; do
+    bench_create $creators
+done
+
+
+echo
+echo "mask translation time in nanoseconds (PIN_MAP = permutation of 1024 cpus)"
+printf "%-10s %-10s %-10s\n" cpus loop pin
+PIN_MAP="$MAP" "$BIN/mapping"
+
+
+echo
+echo "sched_getcpu() time in nanoseconds per call"
+printf "%-10s %-10s %-10s\n" native pin pin-map
+printf "%-10s %-10s %-10s\n" `"$BIN/getcpu"` \
+       `LD_PRELOAD="$LIB" "$BIN/getcpu"` \
+       `PIN_MAP="$MAP" LD_PRELOAD="$LIB" "$BIN/getcpu"`
+
+
+NODES=`ls -d /sys/devices/system/node/node[0-9]* 2>/dev/null \
+       | sed 's,.*/node,,' | sort -n`
+CPU=`cut -d, -f1 /sys/devices/system/node/node0/cpulist 2>/dev/null \
+     | cut -d- -f1`
+
+if [ "x$CPU" != "x" ] ; then
+    echo
+    echo "read bandwidth in megabytes per second from core $CPU (node 0)"
+    printf "%-12s %-10s\n" memory bandwidth
+    for node in $NODES ; do
+	printf "%-12s %-10s\n" "node$node" \
+	       `PIN_RR="$CPU" LD_PRELOAD="$LIB" "$BIN/bandwidth" 256 $node`
+    done
+    for policy in bind interleave ; do
+	printf "%-12s %-10s\n" "$policy" \
+	       `PIN_RR="$CPU" PIN_MEMPOLICY=$policy LD_PRELOAD="$LIB" \
+		"$BIN/bandwidth" 256`
+    done
+fi
@@ -45,32 +45,34 @@ compare()
     return 0
 }
 
-check_config()
+check_program()
 {
     out=`mktemp`
     cor=`mktemp`
-    name="$1"
-    args="$2"
-    rr="$3"
-    map="$4"
-    exp="$5"
+    name="$1" ; shift
+    prog="$1" ; shift
+    args="$1" ; shift
+    exp="$1" ; shift
 
     set -m
     (
-	if [ "x$rr" != "x" ] ; then
-	    export PIN_RR="$rr"
-	fi
-	if [ "x$map" != "x" ] ; then
-	    export PIN_MAP="$map"
-	fi
 	export LD_PRELOAD="$LIB"
+	for assign in "$@" ; do
+	    export "$assign"
+	done
 
-	"$BIN/pthread" $args  > "$out"
+	"$BIN/$prog" $args  > "$out"
     ) &
     pid=$!
     set +m
 
-    sleep 11
+    for sec in `seq 1 11` ; do
+	if ! ps $pid >/dev/null ; then
+	    break
+	fi
+	sleep 1
+    done
+
     if ps $pid >/dev/null ; then
 	kill -TERM -$pid
 	echo "timeout config $name" >&2
@@ -92,6 +94,69 @@ check_config()
     rm "$out" "$cor"
 }
 
+fake_cpulist()
+{
+    mkdir -p "$SYSFS/`dirname "$1"`"
+    echo "$2" > "$SYSFS/$1"
+}
+
+check_config()
+{
+    name="$1"
+    args="$2"
+    rr="$3"
+    map="$4"
+    exp="$5"
+
+    set -- "$name" pthread "$args" "$exp"
+    if [ "x$rr" != "x" ] ; then
+	set -- "$@" "PIN_RR=$rr"
+    fi
+    if [ "x$map" != "x" ] ; then
+	set -- "$@" "PIN_MAP=$map"
+    fi
+
+    check_program "$@"
+}
+
+
+SYSFS=`mktemp -d`
+trap 'rm -rf "$SYSFS"' EXIT
+
+fake_cpulist devices/system/node/node0/cpulist  "0-3"
+fake_cpulist devices/system/node/node1/cpulist  "4-7"
+fake_cpulist devices/system/node/node2/cpulist  ""
+
+fake_cpulist devices/system/cpu/online          "0-7"
+for cpu in `seq 0 7` ; do
+    core=$(( cpu % 4 ))
+    package=$(( core / 2 ))
+    dir="devices/system/cpu/cpu$cpu"
+
+    fake_cpulist "$dir/topology/physical_package_id"  "$package"
+    fake_cpulist "$dir/topology/die_id"               "0"
+    fake_cpulist "$dir/topology/core_cpus_list"       "$core,$(( core + 4 ))"
+    fake_cpulist "$dir/cache/index0/level"            "1"
+    fake_cpulist "$dir/cache/index0/type"             "Data"
+    fake_cpulist "$dir/cache/index0/shared_cpu_list"  "$core,$(( core + 4 ))"
+    fake_cpulist "$dir/cache/index1/level"            "3"
+    fake_cpulist "$dir/cache/index1/type"             "Unified"
+    fake_cpulist "$dir/cache/index1/shared_cpu_list" \
+		 "$(( package * 2 ))-$(( package * 2 + 1 )),$(( package * 2 + 4 ))-$(( package * 2 + 5 ))"
+done
+
+fake_cpulist devices/cpu_core/cpus              "0-1,4-5"
+fake_cpulist devices/cpu_atom/cpus              "2-3,6-7"
+
+CAPACITY="$SYSFS/capacity"
+mkdir -p "$CAPACITY/devices/system/cpu"
+echo "0-3" > "$CAPACITY/devices/system/cpu/online"
+for cpu in `seq 0 3` ; do
+    mkdir -p "$CAPACITY/devices/system/cpu/cpu$cpu"
+    echo $(( cpu < 2 ? 1024 : 512 )) \
+	 > "$CAPACITY/devices/system/cpu/cpu$cpu/cpu_capacity"
+done
+
 
 #            Test name        args         PIN_RR    PIN_MAP    expected
 check_config "main 0"         0            0         ""         1
@@ -103,3 +168,169 @@ check_config "multi range"    "0 0 0 0 0"  "0-2 3"   ""         "7 8 7 8 7"
 check_config "nomap"          "1 2"        ""        ""         "1 2"
 check_config "map"            "1 2"        ""        "0=2 1=3"  "1 2"
 check_config "pinmap"         "0 0"        "2 3"     "0=2 1=3"  "1 2"
+
+
+#             Test name        program  args  expected     environment
+check_program "first single"   first    3     "1 1 1 1"    "PIN_RR=0"
+check_program "first multi"    first    5     "1 2 1 2 1 2" "PIN_RR=0 1"
+check_program "first choice"   first    4     "3 c 3 c 3"  "PIN_RR=0,1 2,3"
+
+printf '0 - 3\n0.0 - 2\n0.1 - 1\n0.2 - 0\n' > "$SYSFS/manifest"
+check_program "replay"         first    3     "8 4 2 1"    "PIN_RR=0 1 2 3" \
+	      "PIN_REPLAY=$SYSFS/manifest"
+check_program "record"         first    3     "1 2 4 8"    "PIN_RR=0 1 2 3" \
+	      "PIN_RECORD=$SYSFS/recorded"
+check_program "record replay"  first    3     "1 2 4 8"    "PIN_RR=0 1 2 3" \
+	      "PIN_REPLAY=$SYSFS/recorded"
+check_program "churn single"   churn    "1 32" "0"        "PIN_RR=0"
+check_program "churn multi"    churn    "4 64" "1"        "PIN_RR=0 1 2 3"
+check_program "sched nomap"    affinity "sched 1"   "1 1 1"
+check_program "sched map"      affinity "sched 2"   "1 2 2"   "PIN_MAP=0=1 1=0"
+check_program "pthread nomap"  affinity "pthread 1" "1 1 1"
+check_program "pthread map"    affinity "pthread 2" "1 2 2"   "PIN_MAP=0=1 1=0"
+check_program "attr nomap"     affinity "attr 1"    "1 1 1"
+check_program "attr map"       affinity "attr 2"    "1 2 2"   "PIN_MAP=0=1 1=0"
+check_program "getcpu map"     affinity "sched 8"   "4 8 8"   "PIN_MAP=2=3 3=2"
+check_program "getcpu map 4"   affinity "sched 8 4" "4 8 8"   "PIN_MAP=2=3 3=2"
+check_program "getcpu map 12"  affinity "sched 8 12" "4 8 8"  "PIN_MAP=2=3 3=2"
+check_program "nprocs rr"      nprocs   ""           "1 1 1 1 1 1 1" \
+	      "PIN_RR=0" "PIN_NPROCS=1"
+check_program "nprocs map"     nprocs   ""           "1 1 1 1 8 8 8" \
+	      "PIN_RR=0" "PIN_MAP=0=3 3=0" "PIN_NPROCS=1"
+check_program "nprocs fortify" nprocs-fortify ""     "1 1 1 1 8 8 8" \
+	      "PIN_RR=0" "PIN_MAP=0=3 3=0" "PIN_NPROCS=1"
+check_program "rules"          rules    ""           "2 4 8" \
+	      "PIN_RULES=io_*=1; compact*=2; *=rr:3"
+check_program "hint"           hint     1            "3 5" \
+	      "PIN_RULES=role:latency=0-1; group:workers=0,2; *=0,3"
+check_program "hint static"    hint     1            "3 9" \
+	      "PIN_RULES=role:latency=0-1; group:workers=0,2; *=0,3" \
+	      "LD_PRELOAD="
+check_program "static symbols" symbols  ""           "0"      "LD_PRELOAD="
+check_program "schedule rr"    schedule 3            "5 300 505 0" \
+	      "PIN_RR=0:nice:5 0:batch 0:idle 0:nice:0"
+check_program "schedule rules" schedule 2            "0 4 4" \
+	      "PIN_RULES=display_*=rr:0:nice:4"
+check_program "schedule reset" schedule "0 moved"      "132 0" \
+	      "PIN_RR=0:fifo:50" "PIN_RULES=moved=0"
+check_program "registry"       registry 3            "1 2 4 8" \
+	      "PIN_RR=0 0 0 0" "PIN_REGISTRY=/pin.%p"
+check_program "rebalance none" rebalance 1000        "2" \
+	      "PIN_RR=0 0" "PIN_REGISTRY=/pin.%p"
+check_program "rebalance"      rebalance 1000        "1" \
+	      "PIN_RR=0 0" "PIN_REGISTRY=/pin.%p" "PIN_REBALANCE=100ms"
+
+CONTROL="$SYSFS/control.%p"
+check_program "repin rr"       repin    "2 PIN_RR=1" "2 2 2" \
+	      "PIN_RR=0" "PIN_CONTROL=$CONTROL"
+check_program "repin map"      repin    "2 PIN_MAP=1=0" "2 2 2" \
+	      "PIN_CONTROL=$CONTROL"
+
+check_program "pinrun single"   pinrun   "$BIN/first 3"      "1 1 1 1" \
+	      "PIN_RR=0" "LD_PRELOAD="
+check_program "pinrun multi"    pinrun   "$BIN/first 5"      "1 2 1 2 1 2" \
+	      "PIN_RR=0 1" "LD_PRELOAD="
+check_program "pinrun limit"    pinrun   "-l 2 $BIN/first 3" "1 2 1 1" \
+	      "PIN_RR=0 1" "LD_PRELOAD="
+
+check_program "pind single"     watched  "1 1 $BIN/pind -p 10 %p" "1 1 1" \
+	      "PIN_RR=0" "LD_PRELOAD="
+check_program "pind once"       watched  "2 0 $BIN/pind -o %p" "1 2 1" \
+	      "PIN_RR=0 1" "LD_PRELOAD="
+check_program "pind watch"      watched  "1 2 $BIN/pind -p 10 %p" "1 2 1 2" \
+	      "PIN_RR=0 1" "LD_PRELOAD="
+check_program "pind name"       watched  "0 2 $BIN/pind -p 10 -n watched" \
+	      "1 2 1" "PIN_RR=0 1" "LD_PRELOAD="
+
+TRACE="$SYSFS/trace.bin"
+( export LD_PRELOAD="$LIB" PIN_RR="0" PIN_TRACE="$TRACE"
+  "$BIN/affinity" sched 1 ) > /dev/null
+check_program "trace"           pintrace "-c $TRACE"              "1 1 1 0 0" \
+	      "LD_PRELOAD="
+( export LD_PRELOAD="$LIB" PIN_RR="0" PIN_TRACE="$TRACE"
+  "$BIN/affinity" attr 1 ) > /dev/null
+check_program "trace attr"      pintrace "-c $TRACE"              "2 1 1 0 0" \
+	      "LD_PRELOAD="
+
+check_program "numa interleave" policy   5     "f f0 f f0 f" \
+	      "PIN_NUMA=interleave" "PIN_SYSFS=$SYSFS" "LD_PRELOAD="
+check_program "numa fill"       policy   9     "f f f f f0 f0 f0 f0 f" \
+	      "PIN_NUMA=fill" "PIN_SYSFS=$SYSFS" "LD_PRELOAD="
+check_program "numa fill order" policy   5     "f0 f0 f0 f0 f" \
+	      "PIN_NUMA=fill:1,0" "PIN_SYSFS=$SYSFS" "LD_PRELOAD="
+check_program "numa subset"     policy   3     "f0 f0 f0" \
+	      "PIN_NUMA=interleave:1" "PIN_SYSFS=$SYSFS" "LD_PRELOAD="
+check_program "numa rr"         policy   2     "1 1" \
+	      "PIN_NUMA=interleave" "PIN_RR=0" "PIN_SYSFS=$SYSFS" "LD_PRELOAD="
+check_program "policy compact"  policy   9     "1 10 2 20 4 40 8 80 1" \
+	      "PIN_POLICY=compact" "PIN_SYSFS=$SYSFS" "LD_PRELOAD="
+check_program "policy scatter"  policy   9     "1 4 2 8 10 40 20 80 1" \
+	      "PIN_POLICY=scatter" "PIN_SYSFS=$SYSFS" "LD_PRELOAD="
+check_program "policy per core" policy   5     "11 22 44 88 11" \
+	      "PIN_POLICY=one-per-core" "PIN_SYSFS=$SYSFS" "LD_PRELOAD="
+
+check_program "mempolicy none"       mempolicy "1"   "0 0" "LD_PRELOAD="
+check_program "mempolicy bind"       mempolicy "1 f" "2 1 2 1" \
+	      "PIN_MEMPOLICY=bind" "PIN_SYSFS=$SYSFS" "LD_PRELOAD="
+check_program "mempolicy preferred"  mempolicy "1 f" "1 1 1 1" \
+	      "PIN_MEMPOLICY=preferred" "PIN_SYSFS=$SYSFS" "LD_PRELOAD="
+check_program "mempolicy interleave" mempolicy "1 f" "3 1 3 1" \
+	      "PIN_MEMPOLICY=interleave" "PIN_SYSFS=$SYSFS" "LD_PRELOAD="
+
+check_program "hybrid rr"       policy   7     "1 2 4 8 40 80 1" \
+	      "PIN_RR=P P E*" "PIN_SYSFS=$SYSFS" "LD_PRELOAD="
+check_program "hybrid perf"     policy   5     "1 2 10 20 1" \
+	      "PIN_RR=P*" "PIN_SYSFS=$SYSFS" "LD_PRELOAD="
+check_program "hybrid capacity" policy   4     "4 1 2 4" \
+	      "PIN_RR=E P*" "PIN_SYSFS=$CAPACITY" "LD_PRELOAD="
+
+check_program "group llc"       policy   10    "ff 1 2 10 20 4 8 40 80 1" \
+	      "PIN_GROUP=4" "PIN_SYSFS=$SYSFS" "LD_PRELOAD="
+check_program "group node"      policy   9     "ff 1 2 10 20 4 8 40 80" \
+	      "PIN_GROUP=2:node" "PIN_SYSFS=$SYSFS" "LD_PRELOAD="
+check_program "group partial"   policy   10    "ff 1 2 10 4 8 40 20 1 2" \
+	      "PIN_GROUP=3:llc" "PIN_SYSFS=$SYSFS" "LD_PRELOAD="
+
+check_program "allowed rr"       policy   3     "f 30 f" \
+	      "PIN_RR=0-3 4-7 8" "PIN_TEST_AFFINITY=0-5" "LD_PRELOAD="
+check_program "allowed relative" policy   3     "10 20 10" \
+	      "PIN_RR=0 1 2" "PIN_RELATIVE=1" "PIN_TEST_AFFINITY=4-5" \
+	      "LD_PRELOAD="
+fake_cpulist devices/system/cpu/isolated "0-1"
+check_program "allowed skip"     policy   7     "10 20 4 40 8 80 10" \
+	      "PIN_POLICY=compact" "PIN_SKIP=isolated" "PIN_SYSFS=$SYSFS" \
+	      "LD_PRELOAD="
+rm "$SYSFS/devices/system/cpu/isolated"
+cgroup=`sed -n 's/^0:://p' /proc/self/cgroup`
+if [ "x$cgroup" != "x" ] ; then
+    [ "x$cgroup" = "x/" ] && cgroup=""
+    fake_cpulist "cgroup/fs/cgroup$cgroup/cpuset.cpus.effective" "2-3"
+    check_program "allowed cgroup"   policy   2     "c 4" \
+		  "PIN_RR=0-3 2" "PIN_SYSFS=$SYSFS/cgroup" "LD_PRELOAD="
+fi
+
+SHARED="/pin-check-$$"
+PIN_SHARED="$SHARED" PIN_RR="0 1 2 3" "$BIN/policy" 2 4000 >/dev/null &
+holder=$!
+sleep 1
+check_program "shared spread"   policy   2     "4 8" \
+	      "PIN_SHARED=$SHARED" "PIN_RR=0 1 2 3" "LD_PRELOAD="
+kill -KILL $holder ; wait $holder 2>/dev/null
+check_program "shared reclaim"  policy   4     "1 2 4 8" \
+	      "PIN_SHARED=$SHARED" "PIN_RR=0 1 2 3" "LD_PRELOAD="
+rm -f "/dev/shm/$SHARED"
+
+PIN_SHARED="$SHARED" PIN_RR="0 1 2 3" "$BIN/policy" 1 4000 0 >/dev/null &
+holder=$!
+sleep 1
+check_program "shared fork"     policy   1     "2" \
+	      "PIN_SHARED=$SHARED" "PIN_RR=0 1 2 3" "LD_PRELOAD="
+kill -KILL $holder ; wait $holder 2>/dev/null
+rm -f "/dev/shm/$SHARED"
+
+check_program "mapping none"    mapping  check "1"  "LD_PRELOAD="
+check_program "mapping sparse"  mapping  check "1" \
+	      "PIN_MAP=0=2 1=3 64=65 65=64 300=900" "LD_PRELOAD="
+check_program "mapping dense"   mapping  check "1" \
+	      "PIN_MAP=`seq 0 1023 | awk '{ printf "%d=%d ", $1, ($1 * 37) % 1024 }'`" \
+	      "LD_PRELOAD="
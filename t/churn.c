@@ -0,0 +1,174 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static size_t             mask_count = 0;
+static size_t             resident_count = 0;
+static cpu_set_t         *resident_masks = NULL;
+static pthread_barrier_t  resident_barrier;
+
+
+static void usage(void)
+{
+	printf("Usage: churn <mask-count> <resident-count>\n"
+	       "Launch <resident-count> long lived threads while creating "
+	       "and destroying\n"
+	       "short lived threads in between. When all the long lived "
+	       "threads are running,\n"
+	       "group the main and long lived threads by affinity mask and "
+	       "print the\n"
+	       "difference between the most and the least populated of the "
+	       "<mask-count>\n"
+	       "masks.\n");
+}
+
+
+static void *resident(void *arg)
+{
+	cpu_set_t *mask = (cpu_set_t *) arg;
+
+	pthread_barrier_wait(&resident_barrier);
+	sched_getaffinity(0, sizeof (*mask), mask);
+	pthread_barrier_wait(&resident_barrier);
+
+	return NULL;
+}
+
+static void *transient(void *arg)
+{
+	size_t id = (size_t) arg;
+
+	if (id & 1)
+		pthread_exit(NULL);
+	return NULL;
+}
+
+static void parse_arguments(int argc, const char **argv)
+{
+	const char *name = argv[0];
+	char *err;
+
+	if (argc > 1 && (!strcmp(argv[1], "--help")
+			 || !strcmp(argv[1], "-h"))) {
+		usage();
+		exit(EXIT_SUCCESS);
+	}
+
+	if (argc != 3)
+		goto err;
+
+	mask_count = strtol(argv[1], &err, 10);
+	if (*err != '\0' || mask_count == 0)
+		goto err;
+
+	resident_count = strtol(argv[2], &err, 10);
+	if (*err != '\0')
+		goto err;
+
+	resident_masks = malloc(sizeof (cpu_set_t) * (resident_count + 1));
+	if (resident_masks == NULL)
+		abort();
+
+	return;
+ err:
+	fprintf(stderr, "%s: invalid arguments\n"
+		"Please type '%s --help' for more informations\n",
+		name, name);
+	exit(EXIT_FAILURE);
+}
+
+static void churn(size_t round)
+{
+	pthread_t tids[4];
+	size_t i, count = 1 + (round % 4);
+
+	for (i=0; i<count; i++)
+		pthread_create(&tids[i], NULL, transient, (void *) (round + i));
+	for (i=0; i<count; i++)
+		pthread_join(tids[i], NULL);
+}
+
+static size_t imbalance(void)
+{
+	size_t *populations = calloc(resident_count + 1, sizeof (size_t));
+	size_t i, j, groups = 0, min, max = 0;
+
+	if (populations == NULL)
+		abort();
+
+	for (i=0; i <= resident_count; i++) {
+		for (j=0; j<i; j++)
+			if (CPU_EQUAL(resident_masks + i, resident_masks + j))
+				break;
+		if (j == i)
+			groups++;
+		populations[j]++;
+	}
+
+	min = (groups < mask_count) ? 0 : resident_count + 1;
+	for (i=0; i <= resident_count; i++) {
+		if (populations[i] == 0)
+			continue;
+		if (populations[i] > max)
+			max = populations[i];
+		if (populations[i] < min)
+			min = populations[i];
+	}
+
+	free(populations);
+	return max - min;
+}
+
+int main(int argc, const char **argv)
+{
+	pthread_t *tids;
+	size_t i;
+
+	parse_arguments(argc, argv);
+
+	tids = malloc(sizeof (pthread_t) * resident_count);
+	if (resident_count > 0 && tids == NULL)
+		abort();
+
+	pthread_barrier_init(&resident_barrier, NULL, resident_count + 1);
+
+	for (i=0; i<resident_count; i++) {
+		pthread_create(&tids[i], NULL, resident, resident_masks + i + 1);
+		churn(i);
+	}
+
+	pthread_barrier_wait(&resident_barrier);
+	sched_getaffinity(0, sizeof (*resident_masks), resident_masks);
+	pthread_barrier_wait(&resident_barrier);
+
+	for (i=0; i<resident_count; i++)
+		pthread_join(tids[i], NULL);
+
+	printf("%lx\n", imbalance());
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define SECOND       (1000000000ul)
+
+static size_t             creator_count = 1;
+static size_t             create_count = 256;
+static unsigned long     *latencies = NULL;
+static pthread_barrier_t  creator_barrier;
+
+
+static void usage(void)
+{
+	printf("Usage: create [<creator-count> [<create-count>]]\n"
+	       "Launch <creator-count> threads [default = 1] which "
+	       "concurrently create and\n"
+	       "join <create-count> threads each [default = 256]. When "
+	       "done, print the median\n"
+	       "and the 99th percentile of the pthread_create() latency in "
+	       "nanoseconds.\n");
+}
+
+
+static unsigned long gettime()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * SECOND + ts.tv_nsec;
+}
+
+static void *nothing(void *arg)
+{
+	return arg;
+}
+
+static void *creator(void *arg)
+{
+	unsigned long *latency = (unsigned long *) arg;
+	unsigned long start;
+	pthread_t tid;
+	size_t i;
+
+	pthread_barrier_wait(&creator_barrier);
+
+	for (i=0; i<create_count; i++) {
+		start = gettime();
+		if (pthread_create(&tid, NULL, nothing, NULL) != 0)
+			abort();
+		latency[i] = gettime() - start;
+
+		pthread_join(tid, NULL);
+	}
+
+	return NULL;
+}
+
+static void parse_arguments(int argc, const char **argv)
+{
+	const char *name = argv[0];
+	char *err;
+
+	if (argc > 1 && (!strcmp(argv[1], "--help")
+			 || !strcmp(argv[1], "-h"))) {
+		usage();
+		exit(EXIT_SUCCESS);
+	}
+
+	if (argc > 3)
+		goto err;
+
+	if (argc > 1) {
+		creator_count = strtol(argv[1], &err, 10);
+		if (*err != '\0' || creator_count == 0)
+			goto err;
+	}
+
+	if (argc > 2) {
+		create_count = strtol(argv[2], &err, 10);
+		if (*err != '\0' || create_count == 0)
+			goto err;
+	}
+
+	latencies = malloc(sizeof (*latencies) * creator_count
+			   * create_count);
+	if (latencies == NULL)
+		abort();
+
+	return;
+ err:
+	fprintf(stderr, "%s: invalid arguments\n"
+		"Please type '%s --help' for more informations\n",
+		name, name);
+	exit(EXIT_FAILURE);
+}
+
+static int compare_latencies(const void *a, const void *b)
+{
+	unsigned long la = *((const unsigned long *) a);
+	unsigned long lb = *((const unsigned long *) b);
+
+	return (la > lb) - (la < lb);
+}
+
+int main(int argc, const char **argv)
+{
+	size_t i, total;
+	pthread_t *tids;
+
+	parse_arguments(argc, argv);
+
+	tids = malloc(sizeof (pthread_t) * creator_count);
+	if (tids == NULL)
+		abort();
+
+	pthread_barrier_init(&creator_barrier, NULL, creator_count);
+
+	for (i=0; i<creator_count; i++)
+		if (pthread_create(&tids[i], NULL, creator,
+				   latencies + i * create_count) != 0)
+			abort();
+
+	for (i=0; i<creator_count; i++)
+		pthread_join(tids[i], NULL);
+
+	total = creator_count * create_count;
+	qsort(latencies, total, sizeof (*latencies), compare_latencies);
+
+	printf("%lu %lu\n", latencies[total / 2],
+	       latencies[(total * 99) / 100]);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static size_t  thread_count = 0;
+static int    *first_cores = NULL;
+
+
+static void usage(void)
+{
+	printf("Usage: first [<thread-count>]\n"
+	       "Launch the specified amount of threads in addition of the "
+	       "main thread. Each\n"
+	       "thread records the core it runs on as its very first action. "
+	       "When done, the\n"
+	       "mask of this first core is printed (in hexadecimal) for the "
+	       "main thread and\n"
+	       "then for each launched thread.\n");
+}
+
+
+static void *record(void *arg)
+{
+	int *core = (int *) arg;
+
+	*core = sched_getcpu();
+	return NULL;
+}
+
+static void parse_arguments(int argc, const char **argv)
+{
+	const char *name = argv[0];
+	char *err;
+
+	if (argc == 1) {
+		thread_count = 0;
+	} else if (!strcmp(argv[1], "--help") || !strcmp(argv[1], "-h")) {
+		usage();
+		exit(EXIT_SUCCESS);
+	} else {
+		thread_count = strtol(argv[1], &err, 10);
+		if (*err != '\0') {
+			fprintf(stderr, "%s: invalid count '%s'\n"
+				"Please type '%s --help' for more "
+				"informations\n", name, argv[1], name);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	first_cores = malloc(sizeof (*first_cores) * (thread_count + 1));
+	if (first_cores == NULL)
+		abort();
+}
+
+static void display_core(int core)
+{
+	cpu_set_t mask;
+	char cores;
+	size_t i;
+	int display = 0;
+
+	CPU_ZERO(&mask);
+	CPU_SET(core, &mask);
+
+	for (i = (sizeof (mask) << 1) - 1; i < (sizeof (mask) << 1); i--) {
+		cores = (CPU_ISSET(4 * i + 0, &mask) << 0)
+			| (CPU_ISSET(4 * i + 1, &mask) << 1)
+			| (CPU_ISSET(4 * i + 2, &mask) << 2)
+			| (CPU_ISSET(4 * i + 3, &mask) << 3);
+
+		if (cores != 0)
+			display = 1;
+		if (display)
+			printf("%x", cores);
+	}
+
+	printf("\n");
+}
+
+int main(int argc, const char **argv)
+{
+	pthread_t *tids;
+	size_t i;
+
+	parse_arguments(argc, argv);
+	tids = malloc(sizeof (pthread_t) * thread_count);
+	if (thread_count > 0 && tids == NULL)
+		abort();
+
+	record(first_cores);
+
+	for (i=0; i < thread_count; i++)
+		pthread_create(&tids[i], NULL, record, first_cores + i + 1);
+
+	for (i=0; i < thread_count; i++)
+		pthread_join(tids[i], NULL);
+
+	for (i=0; i <= thread_count; i++)
+		display_core(first_cores[i]);
+
+	return EXIT_SUCCESS;
+}
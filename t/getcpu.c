@@ -0,0 +1,85 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define SECOND       (1000000000ul)
+
+
+static size_t calls = 10000000;
+
+
+static void usage(void)
+{
+	printf("Usage: getcpu [<calls>]\n"
+	       "Call sched_getcpu() <calls> times [default = %lu] and print "
+	       "the average time\n"
+	       "per call in nanoseconds.\n", calls);
+}
+
+
+static unsigned long gettime()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * SECOND + ts.tv_nsec;
+}
+
+int main(int argc, const char **argv)
+{
+	unsigned long start, elapsed;
+	size_t i;
+	char *err;
+	int cpu;
+
+	if (argc > 1 && (!strcmp(argv[1], "--help")
+			 || !strcmp(argv[1], "-h"))) {
+		usage();
+		return EXIT_SUCCESS;
+	}
+
+	if (argc > 1) {
+		calls = strtol(argv[1], &err, 10);
+		if (*err != '\0' || calls == 0) {
+			fprintf(stderr, "%s: invalid calls '%s'\n"
+				"Please type '%s --help' for more "
+				"informations\n", argv[0], argv[1], argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	start = gettime();
+	for (i=0; i<calls; i++) {
+		cpu = sched_getcpu();
+		__asm__ volatile ("" : : "r" (cpu));
+	}
+	elapsed = gettime() - start;
+
+	printf("%.2f\n", (double) elapsed / calls);
+
+	return EXIT_SUCCESS;
+}
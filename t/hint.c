@@ -0,0 +1,89 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <libpin.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static void usage(void)
+{
+	printf("Usage: hint <role>\n"
+	       "Give the role <role> to the main thread with pin_hint(), then "
+	       "create a thread\n"
+	       "in the group \"workers\". Print the mask (in hexadecimal) of "
+	       "the main thread\n"
+	       "then of the created thread, as returned by "
+	       "pin_current_mask().\n");
+}
+
+static void print_mask(void)
+{
+	unsigned long mask = 0;
+	cpu_set_t set;
+	int cpu;
+
+	if (pin_current_mask(sizeof (set), &set) != 0) {
+		perror("pin_current_mask");
+		return;
+	}
+
+	for (cpu=0; cpu<64; cpu++)
+		if (CPU_ISSET(cpu, &set))
+			mask |= 1ul << cpu;
+
+	printf("%lx\n", mask);
+	fflush(stdout);
+}
+
+static void *worker(void *arg __attribute__((unused)))
+{
+	pin_hint(PIN_ROLE_DEFAULT);
+	print_mask();
+	return NULL;
+}
+
+int main(int argc, const char **argv)
+{
+	pthread_t thread;
+
+	if (argc != 2 || !strcmp(argv[1], "--help")
+	    || !strcmp(argv[1], "-h")) {
+		usage();
+		return argc == 2 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	if (pin_hint(atoi(argv[1])) != 0) {
+		perror("pin_hint");
+		return EXIT_FAILURE;
+	}
+	print_mask();
+
+	pin_group_begin("workers");
+	pthread_create(&thread, NULL, worker, NULL);
+	pthread_join(thread, NULL);
+	pin_group_end();
+
+	return EXIT_SUCCESS;
+}
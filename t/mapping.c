@@ -0,0 +1,164 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <pin.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define SECOND       (1000000000ul)
+#define MASK_SIZE    (sizeof (cpu_set_t))
+#define MASK_COUNT   256
+
+
+static size_t rounds = 100000;
+
+
+static void usage(void)
+{
+	printf("Usage: mapping [check | <rounds>]\n"
+	       "Translate masks of various densities through the PIN_MAP "
+	       "of the environment,\n"
+	       "once with a cpu per cpu loop and once with pin.so. For each "
+	       "density, print\n"
+	       "the amount of set cpus and the nanoseconds per translation "
+	       "for both methods.\n"
+	       "With 'check', only verify that both methods agree and print "
+	       "1.\n");
+}
+
+
+static unsigned long gettime()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * SECOND + ts.tv_nsec;
+}
+
+static void loop_cpuset(cpu_set_t *dest, const cpu_set_t *src, size_t len)
+{
+	size_t i, count = CPU_COUNT_S(len, src);
+
+	CPU_ZERO_S(len, dest);
+
+	for (i=0; i < (len << 3) && count; i++) {
+		if (!CPU_ISSET_S(i, len, src))
+			continue;
+		CPU_SET_S(map_cpu_forward(i), len, dest);
+		count--;
+	}
+}
+
+static void random_masks(cpu_set_t *masks, size_t count, size_t bits)
+{
+	size_t i, j;
+
+	for (i=0; i<count; i++) {
+		CPU_ZERO_S(MASK_SIZE, masks + i);
+		for (j=0; j<bits; j++)
+			CPU_SET_S(rand() % (MASK_SIZE << 3), MASK_SIZE,
+				  masks + i);
+	}
+}
+
+static int check(size_t bits)
+{
+	cpu_set_t masks[MASK_COUNT], got, exp;
+	size_t i;
+
+	random_masks(masks, MASK_COUNT, bits);
+
+	for (i=0; i<MASK_COUNT; i++) {
+		loop_cpuset(&exp, masks + i, MASK_SIZE);
+		map_cpuset_forward(&got, masks + i, MASK_SIZE);
+		if (!CPU_EQUAL_S(MASK_SIZE, &exp, &got))
+			return -1;
+	}
+
+	return 0;
+}
+
+static unsigned long measure(void (*translate)(cpu_set_t *,
+					       const cpu_set_t *, size_t),
+			     const cpu_set_t *masks)
+{
+	unsigned long start;
+	cpu_set_t dest;
+	size_t i;
+
+	start = gettime();
+	for (i=0; i<rounds; i++) {
+		translate(&dest, masks + (i % MASK_COUNT), MASK_SIZE);
+		__asm__ volatile ("" : : "r" (&dest) : "memory");
+	}
+
+	return (gettime() - start) / rounds;
+}
+
+int main(int argc, const char **argv)
+{
+	static const size_t densities[] = { 1, 4, 16, 64, 256, 1024 };
+	cpu_set_t masks[MASK_COUNT];
+	size_t i;
+	char *err;
+
+	if (argc > 1 && (!strcmp(argv[1], "--help")
+			 || !strcmp(argv[1], "-h"))) {
+		usage();
+		return EXIT_SUCCESS;
+	}
+
+	acquire_arguments();
+
+	if (argc > 1 && !strcmp(argv[1], "check")) {
+		for (i=0; i < sizeof (densities) / sizeof (*densities); i++)
+			if (check(densities[i]) != 0) {
+				fprintf(stderr, "%s: mismatch for %lu cpus\n",
+					argv[0], densities[i]);
+				return EXIT_FAILURE;
+			}
+		printf("1\n");
+		return EXIT_SUCCESS;
+	}
+
+	if (argc > 1) {
+		rounds = strtol(argv[1], &err, 10);
+		if (*err != '\0' || rounds == 0) {
+			fprintf(stderr, "%s: invalid rounds '%s'\n"
+				"Please type '%s --help' for more "
+				"informations\n", argv[0], argv[1], argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (i=0; i < sizeof (densities) / sizeof (*densities); i++) {
+		random_masks(masks, MASK_COUNT, densities[i]);
+		printf("%-10lu %-10lu %-10lu\n", densities[i],
+		       measure(loop_cpuset, masks),
+		       measure(map_cpuset_forward, masks));
+	}
+
+	return EXIT_SUCCESS;
+}
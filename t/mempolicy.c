@@ -0,0 +1,100 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <pin.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+#define MAX_NODES  1024
+
+
+static void usage(void)
+{
+	printf("Usage: mempolicy <mask>...\n"
+	       "Read PIN_MEMPOLICY from the environment like pin.so does, "
+	       "then for each\n"
+	       "mask (in hexadecimal), apply the memory policy of a thread "
+	       "pinned on this\n"
+	       "mask and print the resulting policy mode and node mask (in "
+	       "hexadecimal),\n"
+	       "one per line.\n");
+}
+
+static int parse_mask(cpu_set_t *dest, const char *str)
+{
+	size_t j, size = cpumask_size();
+	unsigned long hexa;
+	char *err;
+
+	hexa = strtoul(str, &err, 16);
+	if (*err != '\0')
+		return -1;
+
+	CPU_ZERO_S(size, dest);
+	for (j=0; j<(sizeof (hexa) << 3); j++)
+		if (hexa & (1ul << j))
+			CPU_SET_S(j, size, dest);
+
+	return 0;
+}
+
+int main(int argc, const char **argv)
+{
+	unsigned long nodemask[MAX_NODES / (sizeof (unsigned long) << 3)];
+	cpu_set_t *mask;
+	int i, mode;
+
+	if (argc > 1 && (!strcmp(argv[1], "--help")
+			 || !strcmp(argv[1], "-h"))) {
+		usage();
+		return EXIT_SUCCESS;
+	}
+
+	acquire_arguments();
+	mask = malloc(cpumask_size());
+
+	for (i=1; i<argc; i++) {
+		if (parse_mask(mask, argv[i]) != 0) {
+			fprintf(stderr, "%s: invalid mask '%s'\n"
+				"Please type '%s --help' for more "
+				"informations\n", argv[0], argv[i], argv[0]);
+			return EXIT_FAILURE;
+		}
+
+		apply_mempolicy(mask);
+
+		memset(nodemask, 0, sizeof (nodemask));
+		if (syscall(SYS_get_mempolicy, &mode, nodemask, MAX_NODES,
+			    NULL, 0) != 0) {
+			perror(argv[0]);
+			return EXIT_FAILURE;
+		}
+
+		printf("%x\n%lx\n", mode, nodemask[0]);
+	}
+
+	free(mask);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sysinfo.h>
+#include <unistd.h>
+
+
+#define BUFFER_SIZE  4096
+
+
+static void usage(void)
+{
+	printf("Usage: nprocs\n"
+	       "Print the number of cpus reported by sysconf(), get_nprocs() "
+	       "and\n"
+	       "get_nprocs_conf(), then the mask (in hexadecimal) of the "
+	       "processors listed\n"
+	       "in /proc/cpuinfo and of the cpus listed in "
+	       "/sys/devices/system/cpu/online\n"
+	       "(read with open()) and /sys/devices/system/cpu/possible "
+	       "(read with openat()),\n"
+	       "one per line.\n");
+}
+
+static unsigned long cpuinfo_mask(void)
+{
+	unsigned long mask = 0;
+	char line[BUFFER_SIZE];
+	unsigned int cpu;
+	FILE *file;
+
+	if ((file = fopen("/proc/cpuinfo", "r")) == NULL)
+		return 0;
+
+	while (fgets(line, sizeof (line), file) != NULL)
+		if (sscanf(line, "processor : %u", &cpu) == 1 && cpu < 64)
+			mask |= 1ul << cpu;
+
+	fclose(file);
+	return mask;
+}
+
+/*
+ * The flags are not known at compile time, so that a build with
+ * _FORTIFY_SOURCE goes through the checked entry points like __open_2().
+ */
+static unsigned long __attribute__((noipa))
+cpulist_mask(const char *path, int flags, int at)
+{
+	unsigned long first, last, mask = 0;
+	char buffer[BUFFER_SIZE], *ptr;
+	ssize_t len;
+	int fd;
+
+	if (at)
+		fd = openat(AT_FDCWD, path, flags);
+	else
+		fd = open(path, flags);
+	if (fd < 0)
+		return 0;
+	len = read(fd, buffer, sizeof (buffer) - 1);
+	close(fd);
+	if (len <= 0)
+		return 0;
+	buffer[len] = '\0';
+
+	ptr = buffer;
+	while (*ptr != '\0' && *ptr != '\n') {
+		first = last = strtoul(ptr, &ptr, 10);
+		if (*ptr == '-')
+			last = strtoul(ptr + 1, &ptr, 10);
+		for (; first <= last && first < 64; first++)
+			mask |= 1ul << first;
+		if (*ptr == ',')
+			ptr++;
+	}
+
+	return mask;
+}
+
+int main(int argc, const char **argv)
+{
+	if (argc > 1 && (!strcmp(argv[1], "--help")
+			 || !strcmp(argv[1], "-h"))) {
+		usage();
+		return EXIT_SUCCESS;
+	}
+
+	printf("%lx\n", sysconf(_SC_NPROCESSORS_ONLN));
+	printf("%lx\n", sysconf(_SC_NPROCESSORS_CONF));
+	printf("%x\n", get_nprocs());
+	printf("%x\n", get_nprocs_conf());
+	printf("%lx\n", cpuinfo_mask());
+	printf("%lx\n", cpulist_mask("/sys/devices/system/cpu/online",
+				     O_RDONLY, 0));
+	printf("%lx\n", cpulist_mask("/sys/devices/system/cpu/possible",
+				     O_RDONLY, 1));
+
+	return EXIT_SUCCESS;
+}
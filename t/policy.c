@@ -0,0 +1,158 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <pin.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+
+static void usage(void)
+{
+	printf("Usage: policy [<count> [<hold-ms> [<after-fork>]]]\n"
+	       "Build the pin mask table from the environment like pin.so "
+	       "does, then print\n"
+	       "the <count> first masks it hands out (in hexadecimal), one "
+	       "per line.\n"
+	       "A mask of 0 is printed when there is no mask to hand "
+	       "out.\n"
+	       "If <hold-ms> is specified, keep the masks in use for this "
+	       "amount of\n"
+	       "milliseconds before to exit.\n"
+	       "If <after-fork> is specified, fork a child which exits at "
+	       "once, then print\n"
+	       "<after-fork> more masks.\n"
+	       "The process is considered allowed on every cpu, or on the "
+	       "cpus listed in\n"
+	       "PIN_TEST_AFFINITY if set.\n");
+}
+
+static void display_mask(const cpu_set_t *mask)
+{
+	size_t i, size = cpumask_size();
+	int display = 0;
+	char cores;
+
+	for (i = (size << 1) - 1; i < (size << 1); i--) {
+		cores = (CPU_ISSET_S(4 * i + 0, size, mask) << 0)
+			| (CPU_ISSET_S(4 * i + 1, size, mask) << 1)
+			| (CPU_ISSET_S(4 * i + 2, size, mask) << 2)
+			| (CPU_ISSET_S(4 * i + 3, size, mask) << 3);
+
+		if (cores != 0)
+			display = 1;
+		if (display)
+			printf("%x", cores);
+	}
+
+	if (!display)
+		printf("0");
+	printf("\n");
+}
+
+static void display_masks(size_t count)
+{
+	const cpu_set_t *mask;
+	struct slot slot;
+	size_t i;
+
+	for (i=0; i<count; i++) {
+		mask = get_next_cpumask(&slot, NULL);
+		if (mask == NULL) {
+			printf("0\n");
+			continue;
+		}
+		display_mask(mask);
+	}
+}
+
+int main(int argc, const char **argv)
+{
+	size_t count = 1, hold = 0, after = 0;
+	char every[32];
+	struct timespec ts;
+	char *err;
+
+	if (argc > 1 && (!strcmp(argv[1], "--help")
+			 || !strcmp(argv[1], "-h"))) {
+		usage();
+		return EXIT_SUCCESS;
+	}
+
+	if (argc > 1) {
+		count = strtol(argv[1], &err, 10);
+		if (*err != '\0') {
+			fprintf(stderr, "%s: invalid count '%s'\n"
+				"Please type '%s --help' for more "
+				"informations\n", argv[0], argv[1], argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (argc > 2) {
+		hold = strtol(argv[2], &err, 10);
+		if (*err != '\0') {
+			fprintf(stderr, "%s: invalid hold time '%s'\n"
+				"Please type '%s --help' for more "
+				"informations\n", argv[0], argv[2], argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (argc > 3) {
+		after = strtol(argv[3], &err, 10);
+		if (*err != '\0') {
+			fprintf(stderr, "%s: invalid count '%s'\n"
+				"Please type '%s --help' for more "
+				"informations\n", argv[0], argv[3], argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	snprintf(every, sizeof (every), "0-%lu", cpumask_size() * 8 - 1);
+	setenv("PIN_TEST_AFFINITY", every, 0);
+
+	acquire_arguments();
+
+	display_masks(count);
+
+	if (argc > 3) {
+		fflush(stdout);
+		if (fork() == 0)
+			exit(EXIT_SUCCESS);
+		wait(NULL);
+		display_masks(after);
+	}
+
+	if (hold > 0) {
+		fflush(stdout);
+		ts.tv_sec = hold / 1000;
+		ts.tv_nsec = (hold % 1000) * 1000000ul;
+		while (nanosleep(&ts, &ts) != 0)
+			;
+	}
+
+	return EXIT_SUCCESS;
+}
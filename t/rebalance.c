@@ -0,0 +1,146 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "registry.h"
+
+
+static volatile int  running = 1;
+static pid_t         spinners[2];
+
+
+static void usage(void)
+{
+	printf("Usage: rebalance <ms>\n"
+	       "Create a busy thread, an idle thread, then another busy "
+	       "thread and let them\n"
+	       "run for <ms> milliseconds. Then read the registry exported by "
+	       "pin.so with\n"
+	       "PIN_REGISTRY=/pin.%%p and print 1 if the busy threads use "
+	       "different masks,\n"
+	       "or 2 otherwise.\n");
+}
+
+static void *spin(void *arg)
+{
+	*((pid_t *) arg) = syscall(SYS_gettid);
+	while (running)
+		;
+	return NULL;
+}
+
+static void *idle(void *arg __attribute__((unused)))
+{
+	while (running)
+		usleep(1000);
+	return NULL;
+}
+
+static long mask_of(const struct registry_header *header, pid_t tid)
+{
+	struct registry_record record;
+	size_t i;
+
+	for (i=0; i<header->records; i++) {
+		read_registry_record(&record, &header->record[i]);
+		if (record.tid == tid)
+			return record.mask;
+	}
+
+	return -1;
+}
+
+static int display_spread(void)
+{
+	size_t size = registry_size(REGISTRY_RECORDS);
+	const struct registry_header *header;
+	long first, second;
+	char name[64];
+	int fd;
+
+	sprintf(name, "/pin.%d", getpid());
+	if ((fd = shm_open(name, O_RDONLY, 0)) < 0)
+		return -1;
+	header = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (header == MAP_FAILED)
+		return -1;
+
+	first = mask_of(header, spinners[0]);
+	second = mask_of(header, spinners[1]);
+	printf("%d\n", (first >= 0 && second >= 0 && first != second) ? 1 : 2);
+
+	munmap((void *) header, size);
+	return 0;
+}
+
+int main(int argc, const char **argv)
+{
+	pthread_t threads[3];
+	struct timespec ts;
+	unsigned long ms;
+	size_t i;
+	char *err;
+	int ret;
+
+	if (argc > 1 && (!strcmp(argv[1], "--help")
+			 || !strcmp(argv[1], "-h"))) {
+		usage();
+		return EXIT_SUCCESS;
+	}
+
+	if (argc != 2 || (ms = strtoul(argv[1], &err, 10), *err != '\0')) {
+		fprintf(stderr, "%s: invalid arguments\n"
+			"Please type '%s --help' for more informations\n",
+			argv[0], argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	pthread_create(&threads[0], NULL, spin, &spinners[0]);
+	pthread_create(&threads[1], NULL, idle, NULL);
+	pthread_create(&threads[2], NULL, spin, &spinners[1]);
+
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000ul;
+	while (nanosleep(&ts, &ts) != 0)
+		;
+
+	ret = display_spread();
+	running = 0;
+
+	for (i=0; i<3; i++)
+		pthread_join(threads[i], NULL);
+
+	if (ret != 0) {
+		fprintf(stderr, "%s: cannot read the registry\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "registry.h"
+
+
+static pthread_barrier_t  barrier;
+
+
+static void usage(void)
+{
+	printf("Usage: registry <count>\n"
+	       "Create <count> threads, then read the registry exported by "
+	       "pin.so with\n"
+	       "PIN_REGISTRY=/pin.%%p and print, for the main thread and each "
+	       "created thread\n"
+	       "in the order of their tid, the index of their mask as a bit "
+	       "(in hexadecimal).\n");
+}
+
+static void *run(void *arg __attribute__((unused)))
+{
+	pthread_barrier_wait(&barrier);
+	pthread_barrier_wait(&barrier);
+	return NULL;
+}
+
+static int compare_tid(const void *a, const void *b)
+{
+	const struct registry_record *ra = a, *rb = b;
+
+	return ra->tid - rb->tid;
+}
+
+static int display_registry(void)
+{
+	size_t i, count = 0, size = registry_size(REGISTRY_RECORDS);
+	const struct registry_header *header;
+	struct registry_record *records;
+	char name[64];
+	int fd;
+
+	sprintf(name, "/pin.%d", getpid());
+	if ((fd = shm_open(name, O_RDONLY, 0)) < 0)
+		return -1;
+	header = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (header == MAP_FAILED)
+		return -1;
+	if (header->magic != REGISTRY_MAGIC || header->pid != getpid())
+		return -1;
+
+	records = malloc(sizeof (*records) * header->records);
+	for (i=0; i<header->records; i++) {
+		read_registry_record(&records[count], &header->record[i]);
+		if (records[count].tid != 0)
+			count++;
+	}
+
+	qsort(records, count, sizeof (*records), compare_tid);
+
+	for (i=0; i<count; i++) {
+		if (records[i].mask < 0)
+			printf("0\n");
+		else
+			printf("%lx\n", 1ul << records[i].mask);
+	}
+
+	free(records);
+	munmap((void *) header, size);
+	return 0;
+}
+
+int main(int argc, const char **argv)
+{
+	pthread_t *threads;
+	size_t i, count;
+	char *err;
+	int ret;
+
+	if (argc > 1 && (!strcmp(argv[1], "--help")
+			 || !strcmp(argv[1], "-h"))) {
+		usage();
+		return EXIT_SUCCESS;
+	}
+
+	if (argc != 2 || (count = strtol(argv[1], &err, 10), *err != '\0')) {
+		fprintf(stderr, "%s: invalid arguments\n"
+			"Please type '%s --help' for more informations\n",
+			argv[0], argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	threads = malloc(sizeof (*threads) * count);
+	pthread_barrier_init(&barrier, NULL, count + 1);
+
+	for (i=0; i<count; i++)
+		pthread_create(&threads[i], NULL, run, NULL);
+
+	pthread_barrier_wait(&barrier);
+	ret = display_registry();
+	pthread_barrier_wait(&barrier);
+
+	for (i=0; i<count; i++)
+		pthread_join(threads[i], NULL);
+
+	if (ret != 0) {
+		fprintf(stderr, "%s: cannot read the registry\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
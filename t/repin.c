@@ -0,0 +1,169 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+static pthread_barrier_t  barrier;
+static cpu_set_t         *masks;
+
+
+static void usage(void)
+{
+	printf("Usage: repin <count> <request>...\n"
+	       "Create <count> threads, send the requests to the control "
+	       "socket of pin.so\n"
+	       "given by PIN_CONTROL, then print the affinity of the main "
+	       "thread and of\n"
+	       "each created thread (in hexadecimal), one per line.\n");
+}
+
+static void display_mask(const cpu_set_t *mask)
+{
+	unsigned long hexa = 0;
+	size_t j;
+
+	for (j=0; j<(sizeof (hexa) << 3); j++)
+		if (CPU_ISSET(j, mask))
+			hexa |= (1ul << j);
+
+	printf("%lx\n", hexa);
+}
+
+static void *run(void *arg)
+{
+	cpu_set_t *mask = arg;
+
+	pthread_barrier_wait(&barrier);
+	sched_getaffinity(0, sizeof (*mask), mask);
+	pthread_barrier_wait(&barrier);
+
+	return NULL;
+}
+
+static int connect_control(void)
+{
+	const char *pattern = getenv("PIN_CONTROL");
+	struct sockaddr_un addr;
+	size_t i, pos = 0;
+	int fd;
+
+	if (pattern == NULL)
+		return -1;
+
+	memset(&addr, 0, sizeof (addr));
+	addr.sun_family = AF_UNIX;
+
+	for (i=0; pattern[i] != '\0'; i++) {
+		if (pos + 16 >= sizeof (addr.sun_path))
+			return -1;
+		if (pattern[i] == '%' && pattern[i + 1] == 'p') {
+			pos += sprintf(addr.sun_path + pos, "%d", getpid());
+			i++;
+		} else {
+			addr.sun_path[pos++] = pattern[i];
+		}
+	}
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		return -1;
+	if (connect(fd, (struct sockaddr *) &addr, sizeof (addr)) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int send_requests(int count, const char **requests)
+{
+	char reply[512];
+	FILE *stream;
+	int i, fd;
+
+	if ((fd = connect_control()) < 0)
+		return -1;
+	if ((stream = fdopen(fd, "r")) == NULL)
+		return -1;
+
+	for (i=0; i<count; i++) {
+		dprintf(fd, "%s\n", requests[i]);
+		if (fgets(reply, sizeof (reply), stream) == NULL)
+			return -1;
+		if (strcmp(reply, "ok\n") != 0) {
+			fprintf(stderr, "%s", reply);
+			return -1;
+		}
+	}
+
+	fclose(stream);
+	return 0;
+}
+
+int main(int argc, const char **argv)
+{
+	pthread_t *threads;
+	size_t i, count;
+	char *err;
+
+	if (argc > 1 && (!strcmp(argv[1], "--help")
+			 || !strcmp(argv[1], "-h"))) {
+		usage();
+		return EXIT_SUCCESS;
+	}
+
+	if (argc < 2 || (count = strtol(argv[1], &err, 10), *err != '\0')) {
+		fprintf(stderr, "%s: invalid arguments\n"
+			"Please type '%s --help' for more informations\n",
+			argv[0], argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	threads = malloc(sizeof (*threads) * count);
+	masks = calloc(count + 1, sizeof (*masks));
+	pthread_barrier_init(&barrier, NULL, count + 1);
+
+	for (i=0; i<count; i++)
+		pthread_create(&threads[i], NULL, run, &masks[i + 1]);
+
+	if (send_requests(argc - 2, argv + 2) != 0) {
+		fprintf(stderr, "%s: failed to reconfigure pin\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	pthread_barrier_wait(&barrier);
+	sched_getaffinity(0, sizeof (masks[0]), &masks[0]);
+	pthread_barrier_wait(&barrier);
+
+	for (i=0; i<count; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i=0; i<=count; i++)
+		display_mask(&masks[i]);
+
+	return EXIT_SUCCESS;
+}
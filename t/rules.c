@@ -0,0 +1,103 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static pthread_barrier_t  barrier;
+static cpu_set_t          masks[3];
+
+
+static void usage(void)
+{
+	printf("Usage: rules\n"
+	       "Create three threads: one starting in io_loop(), one "
+	       "starting in work_loop()\n"
+	       "and named 'compact-0' once started, one starting in "
+	       "work_loop() and left\n"
+	       "unnamed. Then print the affinity of each thread (in "
+	       "hexadecimal), one per\n"
+	       "line.\n");
+}
+
+static void display_mask(const cpu_set_t *mask)
+{
+	unsigned long hexa = 0;
+	size_t j;
+
+	for (j=0; j<(sizeof (hexa) << 3); j++)
+		if (CPU_ISSET(j, mask))
+			hexa |= (1ul << j);
+
+	printf("%lx\n", hexa);
+}
+
+static void wait_and_record(cpu_set_t *mask)
+{
+	pthread_barrier_wait(&barrier);
+	pthread_barrier_wait(&barrier);
+	sched_getaffinity(0, sizeof (*mask), mask);
+}
+
+void *io_loop(void *arg)
+{
+	wait_and_record(arg);
+	return NULL;
+}
+
+void *work_loop(void *arg)
+{
+	wait_and_record(arg);
+	return NULL;
+}
+
+int main(int argc, const char **argv)
+{
+	pthread_t threads[3];
+	size_t i;
+
+	if (argc > 1 && (!strcmp(argv[1], "--help")
+			 || !strcmp(argv[1], "-h"))) {
+		usage();
+		return EXIT_SUCCESS;
+	}
+
+	pthread_barrier_init(&barrier, NULL, 4);
+
+	pthread_create(&threads[0], NULL, io_loop, &masks[0]);
+	pthread_create(&threads[1], NULL, work_loop, &masks[1]);
+	pthread_create(&threads[2], NULL, work_loop, &masks[2]);
+
+	pthread_barrier_wait(&barrier);
+	pthread_setname_np(threads[1], "compact-0");
+	pthread_barrier_wait(&barrier);
+
+	for (i=0; i<3; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i=0; i<3; i++)
+		display_mask(&masks[i]);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+static void usage(void)
+{
+	printf("Usage: schedule [<thread-count> [<name>]]\n"
+	       "Launch the specified amount of threads in addition of the "
+	       "main thread, one\n"
+	       "after the other. Print the scheduling policy of the main "
+	       "thread and then of\n"
+	       "each launched thread (in hexadecimal), one per line, as the "
+	       "policy number\n"
+	       "followed by two digits for the real-time priority or the "
+	       "nice value.\n"
+	       "If a name is given, the main thread then renames itself and "
+	       "prints its policy\n"
+	       "again.\n");
+}
+
+void *display_schedule(void *arg __attribute__((unused)))
+{
+	pid_t tid = syscall(SYS_gettid);
+	struct sched_param param;
+	int policy, value;
+
+	policy = sched_getscheduler(tid);
+	if (policy == SCHED_FIFO || policy == SCHED_RR) {
+		sched_getparam(tid, &param);
+		value = param.sched_priority;
+	} else {
+		errno = 0;
+		value = getpriority(PRIO_PROCESS, tid);
+	}
+
+	printf("%x%02x\n", policy, value & 0xff);
+	fflush(stdout);
+	return NULL;
+}
+
+int main(int argc, const char **argv)
+{
+	size_t i, count = 0;
+	pthread_t thread;
+	char *err;
+
+	if (argc > 1 && (!strcmp(argv[1], "--help")
+			 || !strcmp(argv[1], "-h"))) {
+		usage();
+		return EXIT_SUCCESS;
+	}
+
+	if (argc > 1) {
+		count = strtol(argv[1], &err, 10);
+		if (*err != '\0') {
+			fprintf(stderr, "%s: invalid count '%s'\n"
+				"Please type '%s --help' for more "
+				"informations\n", argv[0], argv[1], argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	display_schedule(NULL);
+
+	for (i=0; i<count; i++) {
+		pthread_create(&thread, NULL, display_schedule, NULL);
+		pthread_join(thread, NULL);
+	}
+
+	if (argc > 2) {
+		pthread_setname_np(pthread_self(), argv[2]);
+		display_schedule(NULL);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <libpin.h>
+
+#include <error.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+static void usage(void)
+{
+	printf("Usage: symbols\n"
+	       "Report an error with error(3) from the C library, then print "
+	       "the value returned\n"
+	       "by pin_hint(). Linked with the static libpin, this "
+	       "checks that the\n"
+	       "library does not export its internal symbols.\n");
+}
+
+int main(int argc, const char **argv __attribute__((unused)))
+{
+	if (argc != 1) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	error(0, 0, "expected error %d", 42);
+
+	printf("%d\n", pin_hint(PIN_ROLE_DEFAULT));
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2016 Gauthier Voron <gauthier.voron@lip6.fr>
+ * This file is part of pin.
+ *
+ * Pin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Pin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+
+#define MAX_THREADS  64
+#define SETTLE_MS    200
+
+
+static pid_t            tids[MAX_THREADS + 1];
+static size_t           tids_length = 1;
+static pthread_mutex_t  lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   done = PTHREAD_COND_INITIALIZER;
+static int              finished = 0;
+
+
+static void usage(void)
+{
+	printf("Usage: watched <before> <after> <command>...\n"
+	       "Launch <before> threads, then run the command in background "
+	       "where %%p stands\n"
+	       "for the pid of this process, then launch <after> threads. "
+	       "A moment later,\n"
+	       "print the affinity mask (in hexadecimal) of the main thread "
+	       "and then of each\n"
+	       "launched thread, and terminate the command.\n");
+}
+
+static void *wait_done(void *arg)
+{
+	*((pid_t *) arg) = syscall(SYS_gettid);
+
+	pthread_mutex_lock(&lock);
+	while (!finished)
+		pthread_cond_wait(&done, &lock);
+	pthread_mutex_unlock(&lock);
+
+	return NULL;
+}
+
+static void launch_threads(pthread_t *threads, size_t count)
+{
+	size_t i;
+
+	for (i=0; i<count; i++, tids_length++)
+		pthread_create(&threads[tids_length - 1], NULL, wait_done,
+			       &tids[tids_length]);
+}
+
+static void sleep_ms(unsigned long ms)
+{
+	struct timespec ts = { ms / 1000, (ms % 1000) * 1000000 };
+
+	while (nanosleep(&ts, &ts) != 0)
+		;
+}
+
+static pid_t run_command(char **argv)
+{
+	char pid[16];
+	pid_t child;
+	int i;
+
+	snprintf(pid, sizeof (pid), "%d", getpid());
+	for (i=0; argv[i] != NULL; i++)
+		if (strcmp(argv[i], "%p") == 0)
+			argv[i] = pid;
+
+	if ((child = fork()) == 0) {
+		execvp(argv[0], argv);
+		perror(argv[0]);
+		_exit(EXIT_FAILURE);
+	}
+
+	return child;
+}
+
+static void print_mask(pid_t tid)
+{
+	unsigned long bits = 0;
+	cpu_set_t mask;
+	size_t i;
+
+	CPU_ZERO(&mask);
+	sched_getaffinity(tid, sizeof (mask), &mask);
+
+	for (i=0; i < (sizeof (bits) << 3); i++)
+		if (CPU_ISSET(i, &mask))
+			bits |= 1ul << i;
+
+	printf("%lx\n", bits);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t threads[MAX_THREADS];
+	size_t i, before, after;
+	pid_t child;
+	char *err;
+
+	if (argc > 1 && (!strcmp(argv[1], "--help")
+			 || !strcmp(argv[1], "-h"))) {
+		usage();
+		return EXIT_SUCCESS;
+	}
+
+	if (argc < 4) {
+		fprintf(stderr, "%s: missing arguments\n"
+			"Please type '%s --help' for more informations\n",
+			argv[0], argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	before = strtol(argv[1], &err, 10);
+	if (*err != '\0' || before > MAX_THREADS)
+		return EXIT_FAILURE;
+	after = strtol(argv[2], &err, 10);
+	if (*err != '\0' || before + after > MAX_THREADS)
+		return EXIT_FAILURE;
+
+	tids[0] = getpid();
+
+	launch_threads(threads, before);
+	sleep_ms(SETTLE_MS);
+	child = run_command(argv + 3);
+	sleep_ms(SETTLE_MS);
+	launch_threads(threads, after);
+	sleep_ms(SETTLE_MS);
+
+	for (i=0; i<tids_length; i++)
+		print_mask(tids[i]);
+
+	pthread_mutex_lock(&lock);
+	finished = 1;
+	pthread_cond_broadcast(&done);
+	pthread_mutex_unlock(&lock);
+
+	for (i=0; i < before + after; i++)
+		pthread_join(threads[i], NULL);
+
+	kill(child, SIGTERM);
+	waitpid(child, NULL, 0);
+
+	return EXIT_SUCCESS;
+}